@@ -0,0 +1,32 @@
+// AsyncPlanning.h
+// Results of the coroutine-based API: PointToPointRouter::generatePointToPointRouteAsync and
+// DeliveryPlanner::generateDeliveryPlanAsync return Task<RouteResult> and Task<PlanResult> (see Task.h).
+//
+// The work runs on ThreadPool::shared(), so a process can keep thousands of requests in flight on a handful of
+// threads. The router or planner must outlive every task it returns.
+
+#ifndef ASYNCPLANNING_INCLUDED
+#define ASYNCPLANNING_INCLUDED
+
+#include "provided.h"
+#include "Task.h"
+#include <list>
+#include <vector>
+
+  // The out-parameters of generatePointToPointRoute, by value
+struct RouteResult
+{
+    DeliveryResult result = NO_ROUTE;
+    std::list<StreetSegment> route;
+    double totalDistanceTravelled = 0;
+};
+
+  // The out-parameters of generateDeliveryPlan, by value (commands is empty unless result is DELIVERY_SUCCESS)
+struct PlanResult
+{
+    DeliveryResult result = NO_ROUTE;
+    std::vector<DeliveryCommand> commands;
+    double totalDistanceTravelled = 0;
+};
+
+#endif // ASYNCPLANNING_INCLUDED
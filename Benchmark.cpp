@@ -0,0 +1,925 @@
+// Benchmark.cpp
+// Latency and throughput benchmarks for StreetMap, PointToPointRouter, DeliveryOptimizer and DeliveryPlanner.
+//
+// Usage: benchmarks [mapdata.txt] [deliveries.txt] [--filter=substring] [--min-time=seconds] [--seed=n] [--threads=n]
+//
+// Every benchmark is run repeatedly until it has used up --min-time seconds (and at least a few iterations).
+// Each iteration is timed on its own, so we can report latency percentiles as well as the mean and throughput.
+// --threads sets the shared ThreadPool's worker count (default: one per hardware thread).
+
+#include "provided.h"
+#include "AsyncPlanning.h"
+#include "CommandSerializer.h"
+#include "DeliveryFile.h"
+#include "DeliveryPlan.h"
+#include "ThreadPool.h"
+#include "EdgeWeights.h"
+#include "ExpandableHashMap.h"
+#include "FleetPlan.h"
+#include "Isochrone.h"
+#include "MapTiles.h"
+#include "Polyline.h"
+#include "RouteCache.h"
+#include "RoutePath.h"
+#include "RouteSearch.h"
+#include "RouteStats.h"
+#include "StreetMapSnapshot.h"
+#include "TurnCosts.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <list>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+namespace
+{
+
+double g_sink = 0;      // Results are folded into this so the compiler cannot discard the work being timed
+
+class BenchmarkRunner
+{
+  public:
+    BenchmarkRunner(string filter, double minTime)
+     : m_filter(filter), m_minTime(minTime), m_headerPrinted(false)
+    {}
+
+      // Runs body repeatedly and prints one result row. Each call to body counts as one sample that performs
+      // opsPerIteration operations; latencies are reported per operation. Returns false if filtered out.
+    bool run(const string& name, const function<void()>& body, int opsPerIteration = 1, int minIterations = 5);
+      // Whether run(name, ...) would run, so expensive setup for a filtered-out benchmark can be skipped
+    bool wants(const string& name) const { return m_filter.empty() || name.find(m_filter) != string::npos; }
+
+  private:
+    string m_filter;
+    double m_minTime;
+    bool m_headerPrinted;
+
+    static double percentile(const vector<double>& sorted, double p);
+    static string formatTime(double seconds);
+};
+
+bool BenchmarkRunner::run(const string& name, const function<void()>& body, int opsPerIteration, int minIterations)
+{
+    if (!wants(name))
+        return false;
+
+    if (!m_headerPrinted)
+    {
+        printf("%-66s %10s %10s %10s %10s %10s %10s %14s\n",
+               "Benchmark", "Iterations", "Mean", "p50", "p90", "p99", "Max", "Ops/s");
+        printf("%s\n", string(66 + 6 * 11 + 15, '-').c_str());
+        m_headerPrinted = true;
+    }
+
+    typedef chrono::steady_clock Clock;
+    vector<double> samples;
+    double elapsed = 0;
+    while (elapsed < m_minTime || (int) samples.size() < minIterations)
+    {
+        Clock::time_point t0 = Clock::now();
+        body();
+        Clock::time_point t1 = Clock::now();
+        double seconds = chrono::duration<double>(t1 - t0).count();
+        samples.push_back(seconds / opsPerIteration);   // Per-operation latency of this sample
+        elapsed += seconds;
+    }
+
+    vector<double> sorted = samples;
+    sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (size_t i = 0; i < sorted.size(); i++)
+        total += sorted[i];
+    double mean = total / sorted.size();
+    double opsPerSecond = (double) sorted.size() * opsPerIteration / elapsed;
+
+    printf("%-66s %10zu %10s %10s %10s %10s %10s %14.1f\n", name.c_str(), sorted.size(),
+           formatTime(mean).c_str(), formatTime(percentile(sorted, 0.50)).c_str(),
+           formatTime(percentile(sorted, 0.90)).c_str(), formatTime(percentile(sorted, 0.99)).c_str(),
+           formatTime(sorted.back()).c_str(), opsPerSecond);
+    fflush(stdout);
+    return true;
+}
+
+  // Nearest-rank percentile of an already sorted, non-empty vector
+double BenchmarkRunner::percentile(const vector<double>& sorted, double p)
+{
+    size_t rank = (size_t) (p * sorted.size());
+    if (rank >= sorted.size())
+        rank = sorted.size() - 1;
+    return sorted[rank];
+}
+
+string BenchmarkRunner::formatTime(double seconds)
+{
+    char buf[32];
+    if (seconds < 1e-6)
+        snprintf(buf, sizeof(buf), "%.0f ns", seconds * 1e9);
+    else if (seconds < 1e-3)
+        snprintf(buf, sizeof(buf), "%.2f us", seconds * 1e6);
+    else if (seconds < 1)
+        snprintf(buf, sizeof(buf), "%.2f ms", seconds * 1e3);
+    else
+        snprintf(buf, sizeof(buf), "%.2f s", seconds);
+    return buf;
+}
+
+  // Collects every distinct GeoCoord that appears as a segment endpoint in the map data file.
+  // GeoCoords compare by their text, so we keep the text exactly as it appears in the file.
+bool loadMapNodes(const string& mapFile, vector<GeoCoord>& nodes)
+{
+    ifstream infile(mapFile);
+    if (!infile)
+        return false;
+
+    set<GeoCoord> seen;
+    string line;
+    while (getline(infile, line))
+    {
+          // Street names contain letters; segment counts have fewer than four fields
+        if (find_if(line.begin(), line.end(), [](char c) { return isalpha((unsigned char) c); }) != line.end())
+            continue;
+        istringstream iss(line);
+        string lat1, lon1, lat2, lon2;
+        if (!(iss >> lat1 >> lon1 >> lat2 >> lon2))
+            continue;
+        GeoCoord ends[2] = { GeoCoord(lat1, lon1), GeoCoord(lat2, lon2) };
+        for (int i = 0; i < 2; i++)
+        {
+            if (seen.insert(ends[i]).second)
+                nodes.push_back(ends[i]);
+        }
+    }
+    return true;
+}
+
+  // The line-by-line ifstream/istringstream parser main.cpp used before DeliveryFile.h, kept as a baseline
+bool legacyLoadDeliveries(const string& deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& deliveries)
+{
+    ifstream inf(deliveriesFile);
+    if (!inf)
+        return false;
+    string lat, lon;
+    if (!(inf >> lat >> lon))
+        return false;
+    inf.ignore(10000, '\n');
+    depot = GeoCoord(lat, lon);
+    string line;
+    while (getline(inf, line))
+    {
+        size_t colon = line.find(':');
+        if (colon == string::npos)
+            continue;
+        istringstream iss(line.substr(0, colon));
+        if (iss >> lat >> lon)
+            deliveries.push_back(DeliveryRequest(line.substr(colon + 1), GeoCoord(lat, lon)));
+    }
+    return true;
+}
+
+vector<DeliveryRequest> randomDeliveries(const vector<GeoCoord>& nodes, int n, mt19937& rng)
+{
+    uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+    vector<DeliveryRequest> deliveries;
+    for (int i = 0; i < n; i++)
+        deliveries.push_back(DeliveryRequest("item " + to_string(i), nodes[pick(rng)]));
+    return deliveries;
+}
+
+  // Times one RouteSearch configuration over queries (node pairs), cycling through them, then adds its average nodes
+  // expanded over the first hundred queries to searchStats
+template<typename Weight, typename Heuristic, typename Labels, typename Queue = RadixHeapQueue>
+void benchmarkRouteSearch(BenchmarkRunner& runner, const string& name, const shared_ptr<const StreetMapSnapshot>& map,
+                          const Weight& weight, const function<Heuristic(int)>& heuristicFor,
+                          const vector<pair<int, int>>& queries, vector<string>& searchStats)
+{
+    size_t next = 0;
+    bool ran = runner.run(name, [&]() {
+        const pair<int, int>& query = queries[next++ % queries.size()];
+        RoutePath path;
+        NoRouteStats noStats;
+        RouteSearch<Weight, Heuristic, Labels, NoRouteStats, Queue>::find(map, weight, heuristicFor(query.second), query.first, query.second, path, noStats);
+        g_sink += path.miles();
+    });
+    if (!ran || !is_same<Queue, RadixHeapQueue>::value)
+        return;
+    RouteStats total;
+    for (size_t i = 0; i < queries.size() && i < 100; i++)
+    {
+        RouteStats one;
+        one.queries = 1;
+        CollectRouteStats collect(one);
+        RoutePath path;
+        RouteSearch<Weight, Heuristic, Labels, CollectRouteStats>::find(map, weight, heuristicFor(queries[i].second), queries[i].first, queries[i].second, path, collect);
+        total += one;
+    }
+    ostringstream line;
+    line << name << ": " << total.nodesExpanded / max(1LL, total.queries) << " nodes expanded per query";
+    searchStats.push_back(line.str());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    string mapFile = "mapdata.txt";
+    string deliveriesFile = "deliveries.txt";
+    string filter;
+    double minTime = 0.5;
+    unsigned int seed = 32;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0)
+            filter = arg.substr(9);
+        else if (arg.compare(0, 11, "--min-time=") == 0)
+            minTime = stod(arg.substr(11));
+        else if (arg.compare(0, 7, "--seed=") == 0)
+            seed = (unsigned int) stoul(arg.substr(7));
+        else if (arg.compare(0, 10, "--threads=") == 0)
+            ThreadPool::setSharedWorkerCount((unsigned) stoul(arg.substr(10)));
+        else if (positional == 0)
+        {
+            mapFile = arg;
+            positional++;
+        }
+        else if (positional == 1)
+        {
+            deliveriesFile = arg;
+            positional++;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [mapdata.txt] [deliveries.txt] [--filter=substring] [--min-time=seconds] [--seed=n] [--threads=n]" << endl;
+            return 1;
+        }
+    }
+
+    vector<GeoCoord> nodes;
+    if (!loadMapNodes(mapFile, nodes) || nodes.empty())
+    {
+        cerr << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    GeoCoord depot;
+    vector<DeliveryRequest> fileDeliveries;
+    bool haveDeliveries = loadDeliveryFile(deliveriesFile, depot, fileDeliveries);
+
+    StreetMap sm;
+    if (!sm.load(mapFile))
+    {
+        cerr << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+
+    mt19937 rng(seed);
+    uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+    BenchmarkRunner runner(filter, minTime);
+
+    cout << mapFile << ": " << nodes.size() << " nodes, seed " << seed << "\n\n";
+
+      // StreetMap
+    runner.run("StreetMap/load", [&]() {
+        StreetMap fresh;
+        g_sink += fresh.load(mapFile);
+    }, 1, 3);
+
+    const int lookupsPerIteration = 1000;
+    runner.run("StreetMap/getSegmentsThatStartWith", [&]() {
+        vector<StreetSegment> segs;
+        for (int i = 0; i < lookupsPerIteration; i++)
+        {
+            sm.getSegmentsThatStartWith(nodes[pick(rng)], segs);
+            g_sink += segs.size();
+        }
+    }, lookupsPerIteration);
+
+      // Live updates: close and reopen a random existing segment (two new map versions per iteration)
+    runner.run("StreetMap/closeSegment+reopenSegment", [&]() {
+        vector<StreetSegment> segs;
+        const GeoCoord& gc = nodes[pick(rng)];
+        if (sm.getSegmentsThatStartWith(gc, segs) && !segs.empty())
+        {
+            g_sink += sm.closeSegment(segs[0].start, segs[0].end);
+            g_sink += sm.reopenSegment(segs[0].start, segs[0].end);
+        }
+    }, 2);
+
+      // ExpandableHashMap keyed by this map's GeoCoords, at a few maximum load factors
+    const double loadFactors[] = { 0.5, 1.0, 2.0 };
+    vector<string> hashMapStats;
+    for (double maxLoad : loadFactors)
+    {
+        ostringstream name;
+        name << "ExpandableHashMap/associate+find/maxLoad=" << maxLoad;
+        HashMapStats lastStats;
+        bool ran = runner.run(name.str(), [&]() {
+            ExpandableHashMap<GeoCoord, int> map(maxLoad);
+            for (size_t i = 0; i < nodes.size(); i++)
+                map.associate(nodes[i], (int) i);
+            for (size_t i = 0; i < nodes.size(); i++)
+                g_sink += *map.find(nodes[i]);
+            lastStats = map.stats();
+        }, (int) nodes.size(), 3);
+        if (!ran)
+            continue;
+        ostringstream line;
+        line << "maxLoad=" << maxLoad << ": " << lastStats;
+        hashMapStats.push_back(line.str());
+    }
+
+      // Delivery file parsing: a replay-sized file of 100k deliveries, old parser against DeliveryFileReader
+    const int PARSE_COUNT = 100000;
+    string parseFile = (filesystem::temp_directory_path() / ("delivery_benchmark_" + to_string(seed) + ".txt")).string();
+    {
+        ofstream out(parseFile);
+        out << nodes[0].latitudeText << " " << nodes[0].longitudeText << "\n";
+        for (int i = 0; i < PARSE_COUNT; i++)
+        {
+            const GeoCoord& gc = nodes[pick(rng)];
+            out << gc.latitudeText << " " << gc.longitudeText << ":Order #" << i << " (large pepperoni pizza)\n";
+        }
+    }
+    runner.run("DeliveryFile/legacyParser/deliveries=100k", [&]() {
+        GeoCoord parsedDepot;
+        vector<DeliveryRequest> parsed;
+        legacyLoadDeliveries(parseFile, parsedDepot, parsed);
+        g_sink += parsed.size();
+    }, PARSE_COUNT, 3);
+    runner.run("DeliveryFile/loadDeliveryFile/deliveries=100k", [&]() {
+        GeoCoord parsedDepot;
+        vector<DeliveryRequest> parsed;
+        loadDeliveryFile(parseFile, parsedDepot, parsed);
+        g_sink += parsed.size();
+    }, PARSE_COUNT, 3);
+    runner.run("DeliveryFile/DeliveryFileReader::next/deliveries=100k", [&]() {
+        DeliveryFileReader reader(parseFile);
+        DeliveryRequest request("", GeoCoord());
+        while (reader.next(request))
+            g_sink += request.location.latitude;
+    }, PARSE_COUNT, 3);
+    remove(parseFile.c_str());
+
+      // PointToPointRouter
+    PointToPointRouter router(&sm);
+    int noRoute = 0;
+    runner.run("PointToPointRouter/generatePointToPointRoute/random", [&]() {
+        list<StreetSegment> route;
+        double distance = 0;
+        if (router.generatePointToPointRoute(nodes[pick(rng)], nodes[pick(rng)], route, distance) != DELIVERY_SUCCESS)
+            noRoute++;
+        g_sink += distance;
+    });
+    runner.run("PointToPointRouter/generatePointToPointPath/random", [&]() {
+        RoutePath path;
+        router.generatePointToPointPath(nodes[pick(rng)], nodes[pick(rng)], path);
+        g_sink += path.miles();
+    });
+      // Pairs in different connected parts of the map, which the component labels answer without a search (skipped
+      // if the map is all one piece)
+    {
+        shared_ptr<const StreetMapSnapshot> snapshot = sm.snapshot();
+        vector<pair<GeoCoord, GeoCoord>> cutOff;
+        for (int attempt = 0; attempt < 100000 && cutOff.size() < 100; attempt++)
+        {
+            const GeoCoord& from = nodes[pick(rng)];
+            const GeoCoord& to = nodes[pick(rng)];
+            if (!snapshot->sameComponent(snapshot->nodeId(from), snapshot->nodeId(to)))
+                cutOff.emplace_back(from, to);
+        }
+        size_t next = 0;
+        if (!cutOff.empty())
+            runner.run("PointToPointRouter/generatePointToPointRoute/unreachable", [&]() {
+                list<StreetSegment> route;
+                double distance = 0;
+                const pair<GeoCoord, GeoCoord>& query = cutOff[next++ % cutOff.size()];
+                if (router.generatePointToPointRoute(query.first, query.second, route, distance) == NO_ROUTE)
+                    g_sink += 1;
+            });
+    }
+
+      // RouteSearch configurations (RouteSearch.h) on the same queries: random pairs, and short trips that end a
+      // random walk of 40 segments away from where they start
+    vector<string> searchStats;
+    {
+        shared_ptr<const StreetMapSnapshot> snapshot = sm.snapshot();
+        vector<pair<int, int>> randomQueries;
+        vector<pair<int, int>> shortQueries;
+        for (int i = 0; i < 1000; i++)
+        {
+            int from = snapshot->nodeId(nodes[pick(rng)]);
+            randomQueries.push_back(make_pair(from, snapshot->nodeId(nodes[pick(rng)])));
+            int to = from;
+            for (int step = 0; step < 40 && !snapshot->edges(to).empty(); step++)
+            {
+                EdgeRange out = snapshot->edges(to);
+                to = out.first[rng() % (out.last - out.first)].to;
+            }
+            shortQueries.push_back(make_pair(from, to));
+        }
+        function<CrowHeuristic(int)> crow = [&](int goal) { return CrowHeuristic(*snapshot, goal, 1); };
+        function<NoHeuristic(int)> none = [](int) { return NoHeuristic(); };
+        const pair<string, const vector<pair<int, int>>*> querySets[] = { { "random", &randomQueries }, { "short", &shortQueries } };
+        for (const auto& querySet : querySets)
+        {
+            const vector<pair<int, int>>& queries = *querySet.second;
+            string suffix = "/" + querySet.first;
+            benchmarkRouteSearch<DistanceWeight, CrowHeuristic, DenseLabels>(runner, "RouteSearch/astar/distance/dense" + suffix, snapshot, DistanceWeight(), crow, queries, searchStats);
+            benchmarkRouteSearch<DistanceWeight, CrowHeuristic, SparseLabels>(runner, "RouteSearch/astar/distance/sparse" + suffix, snapshot, DistanceWeight(), crow, queries, searchStats);
+            benchmarkRouteSearch<DistanceWeight, NoHeuristic, DenseLabels>(runner, "RouteSearch/dijkstra/distance/dense" + suffix, snapshot, DistanceWeight(), none, queries, searchStats);
+            benchmarkRouteSearch<HopWeight, NoHeuristic, DenseLabels>(runner, "RouteSearch/dijkstra/hops/dense" + suffix, snapshot, HopWeight(), none, queries, searchStats);
+
+              // The open list alone: the binary and 4-ary heaps against the radix heap the rows above use
+            benchmarkRouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, BinaryHeapQueue>(runner, "RouteSearch/astar/distance/dense/binaryHeap" + suffix, snapshot, DistanceWeight(), crow, queries, searchStats);
+            benchmarkRouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, QuaternaryHeapQueue>(runner, "RouteSearch/astar/distance/dense/4aryHeap" + suffix, snapshot, DistanceWeight(), crow, queries, searchStats);
+            benchmarkRouteSearch<DistanceWeight, NoHeuristic, DenseLabels, BinaryHeapQueue>(runner, "RouteSearch/dijkstra/distance/dense/binaryHeap" + suffix, snapshot, DistanceWeight(), none, queries, searchStats);
+            benchmarkRouteSearch<DistanceWeight, NoHeuristic, DenseLabels, QuaternaryHeapQueue>(runner, "RouteSearch/dijkstra/distance/dense/4aryHeap" + suffix, snapshot, DistanceWeight(), none, queries, searchStats);
+        }
+    }
+
+    RouteStats aggregate;
+    runner.run("PointToPointRouter/generatePointToPointRoute/random/instrumented", [&]() {
+        list<StreetSegment> route;
+        double distance = 0;
+        RouteStats queryStats;
+        router.generatePointToPointRoute(nodes[pick(rng)], nodes[pick(rng)], route, distance, &queryStats);
+        aggregate += queryStats;
+        g_sink += distance;
+    });
+
+      // Node order: the same queries on the map loaded with each numbering. How often an edge joins nodes with nearby
+      // ids (within 64, a few cache lines of per-node search state) stands in for cache-miss counters we cannot read.
+    vector<pair<GeoCoord, GeoCoord>> orderQueries;
+    for (int i = 0; i < 1000; i++)
+        orderQueries.push_back(make_pair(nodes[pick(rng)], nodes[pick(rng)]));
+    const pair<NodeOrder, string> nodeOrders[] = { { FILE_ORDER, "file" }, { HILBERT_ORDER, "hilbert" }, { BFS_ORDER, "bfs" } };
+    vector<string> nearEdgeShares;
+    for (const pair<NodeOrder, string>& order : nodeOrders)
+    {
+        string name = "PointToPointRouter/generatePointToPointRoute/random/order=" + order.second;
+        if (!runner.wants(name))
+            continue;
+        StreetMap ordered;
+        ordered.setNodeOrder(order.first);
+        if (!ordered.load(mapFile))
+            continue;
+        shared_ptr<const StreetMapSnapshot> snapshot = ordered.snapshot();
+        size_t nearEdges = 0;
+        size_t edgeCount = 0;
+        for (int n = 0; n < snapshot->nodeCount(); n++)
+        {
+            for (const GraphEdge& e : snapshot->edges(n))
+            {
+                if (abs(e.to - n) < 64)
+                    nearEdges++;
+                edgeCount++;
+            }
+        }
+        ostringstream line;
+        line << order.second << " " << fixed << setprecision(1) << (edgeCount > 0 ? 100.0 * nearEdges / edgeCount : 0) << "%";
+        nearEdgeShares.push_back(line.str());
+
+        PointToPointRouter orderedRouter(&ordered);
+        size_t nextQuery = 0;
+        runner.run(name, [&]() {
+            const pair<GeoCoord, GeoCoord>& query = orderQueries[nextQuery++ % orderQueries.size()];
+            list<StreetSegment> route;
+            double distance = 0;
+            orderedRouter.generatePointToPointRoute(query.first, query.second, route, distance);
+            g_sink += distance;
+        });
+    }
+
+      // Many-to-many: one pool job per source row
+    const int matrixSizes[] = { 10, 50 };
+    for (int n : matrixSizes)
+    {
+        vector<GeoCoord> points;
+        for (int i = 0; i < n; i++)
+            points.push_back(nodes[pick(rng)]);
+        runner.run("PointToPointRouter/generateDistanceMatrix/N=" + to_string(n), [&]() {
+            vector<double> matrix;
+            router.generateDistanceMatrix(points, matrix);
+            g_sink += matrix.size();
+        }, n * n, 3);
+    }
+
+      // Travel-time routing: a speed profile by street type, first with the plain A* bound, then with ALT landmarks
+    shared_ptr<const StreetMapSnapshot> snapshot = sm.snapshot();
+    shared_ptr<EdgeWeights> travelTime = EdgeWeights::fromSpeeds(*snapshot, [&](const GraphEdge& e) {
+        const string& name = snapshot->streetName(e.name);
+        if (name.find("Boulevard") != string::npos)
+            return 35.0;
+        if (name.find("Avenue") != string::npos || name.find("Drive") != string::npos)
+            return 25.0;
+        return 10.0;
+    });
+    router.setEdgeWeights(travelTime);
+    runner.run("PointToPointRouter/generatePointToPointRoute/random/travelTime", [&]() {
+        list<StreetSegment> route;
+        double distance = 0;
+        router.generatePointToPointRoute(nodes[pick(rng)], nodes[pick(rng)], route, distance);
+        g_sink += distance;
+    });
+    shared_ptr<EdgeWeights> customized = make_shared<EdgeWeights>(*travelTime);
+    runner.run("EdgeWeights/customize/landmarks=8", [&]() {
+        customized->customize(*snapshot, 8);
+    }, 1, 3);
+    if (customized->isCustomized())
+    {
+        router.setEdgeWeights(customized);
+        runner.run("PointToPointRouter/generatePointToPointRoute/random/travelTime+ALT", [&]() {
+            list<StreetSegment> route;
+            double distance = 0;
+            router.generatePointToPointRoute(nodes[pick(rng)], nodes[pick(rng)], route, distance);
+            g_sink += distance;
+        });
+    }
+    router.setEdgeWeights(nullptr);
+
+      // Turn-aware (edge-based) search with the default penalties
+    router.setTurnCosts(make_shared<TurnCosts>());
+    runner.run("PointToPointRouter/generatePointToPointRoute/random/turnCosts", [&]() {
+        list<StreetSegment> route;
+        double distance = 0;
+        router.generatePointToPointRoute(nodes[pick(rng)], nodes[pick(rng)], route, distance);
+        g_sink += distance;
+    });
+    router.setTurnCosts(nullptr);
+
+      // Depot legs (to and from 50 random stops), searched for and then answered from a warmed-up route cache file
+    GeoCoord cacheDepot = nodes[pick(rng)];
+    vector<DeliveryRequest> cacheStops = randomDeliveries(nodes, 50, rng);
+    size_t nextLeg = 0;
+    auto depotLeg = [&]() {
+        const GeoCoord& stop = cacheStops[(nextLeg / 2) % cacheStops.size()].location;
+        bool outbound = nextLeg++ % 2 == 0;
+        list<StreetSegment> route;
+        double distance = 0;
+        router.generatePointToPointRoute(outbound ? cacheDepot : stop, outbound ? stop : cacheDepot, route, distance);
+        g_sink += distance;
+    };
+    runner.run("PointToPointRouter/generatePointToPointRoute/depotLegs", depotLeg);
+    string cacheFile = (filesystem::temp_directory_path() / ("delivery_benchmark_" + to_string(seed) + ".cache")).string();
+    runner.run("RouteCacheBuilder/warmUpDepotLegs/stops=50", [&]() {
+        RouteCacheBuilder builder(&sm);
+        g_sink += builder.warmUpDepotLegs(cacheDepot, cacheStops, cacheStops.size());
+        builder.write(cacheFile);
+    }, 100, 3);
+    router.setRouteCache(RouteCache::open(cacheFile));
+    runner.run("PointToPointRouter/generatePointToPointRoute/depotLegs/routeCache", depotLeg);
+    router.setRouteCache(nullptr);
+    remove(cacheFile.c_str());
+
+      // Service areas: one depot, 16 depots searched in parallel, and sorting an order batch against an area
+    const int DEPOT_COUNT = 16;
+    vector<GeoCoord> depots;
+    for (int i = 0; i < DEPOT_COUNT; i++)
+        depots.push_back(nodes[pick(rng)]);
+    runner.run("StreetMap/reachableWithin/miles=1", [&]() {
+        Isochrone area;
+        sm.reachableWithin(depots[0], 1, area);
+        g_sink += area.size();
+    });
+    runner.run("StreetMap/reachableWithin/depots=16,miles=1", [&]() {
+        vector<Isochrone> areas;
+        sm.reachableWithin(depots, 1, areas);
+        g_sink += areas.back().size();
+    }, DEPOT_COUNT);
+    Isochrone filterArea;
+    sm.reachableWithin(depots[0], 1, filterArea);
+    vector<DeliveryRequest> orderBatch = randomDeliveries(nodes, 1000, rng);
+    runner.run("Isochrone/filter/orders=1000", [&]() {
+        vector<DeliveryRequest> inside;
+        filterArea.filter(orderBatch, inside);
+        g_sink += inside.size();
+    }, (int) orderBatch.size());
+
+      // Tiled maps: the map cut into tiles of 0.005 degrees and loaded on demand, within a budget of the map file's
+      // size (roughly a quarter of what the whole map takes in memory), against the whole map. Queries are short trips (random walks of 40 segments) in one
+      // neighbourhood after another, 50 to each, so tiles are loaded and evicted as the work moves across the map.
+    string tileDirectory = (filesystem::temp_directory_path() / ("delivery_benchmark_" + to_string(seed) + "_tiles")).string();
+    int tiledNodes = 0, wholeNodes = 0;
+    if (runner.wants("PointToPointRouter/generatePointToPointRoute/localTrips/whole") ||
+        runner.wants("PointToPointRouter/generatePointToPointRoute/localTrips/tiled"))
+    {
+        filesystem::create_directories(tileDirectory);
+        shared_ptr<const StreetMapSnapshot> snapshot = sm.snapshot();
+        auto walk = [&](int from, int steps) {
+            for (int step = 0; step < steps && !snapshot->edges(from).empty(); step++)
+            {
+                EdgeRange out = snapshot->edges(from);
+                from = out.first[rng() % (out.last - out.first)].to;
+            }
+            return from;
+        };
+        vector<pair<GeoCoord, GeoCoord>> localTrips;
+        for (int neighbourhood = 0; neighbourhood < 20; neighbourhood++)
+        {
+            int centre = snapshot->nodeId(nodes[pick(rng)]);
+            for (int i = 0; i < 50; i++)
+            {
+                int from = walk(centre, 20);
+                localTrips.emplace_back(snapshot->coord(from), snapshot->coord(walk(from, 40)));
+            }
+        }
+        StreetMap tiledMap;
+        if (splitMapFile(mapFile, tileDirectory, 0.005) &&
+            tiledMap.loadTiles((filesystem::path(tileDirectory) / "index.txt").string(), filesystem::file_size(mapFile)))
+        {
+            PointToPointRouter tiledRouter(&tiledMap);
+            const pair<string, PointToPointRouter*> maps[] = { { "whole", &router }, { "tiled", &tiledRouter } };
+            for (const auto& [suffix, mapRouter] : maps)
+            {
+                size_t next = 0;
+                runner.run("PointToPointRouter/generatePointToPointRoute/localTrips/" + suffix, [&, mapRouter = mapRouter]() {
+                    list<StreetSegment> route;
+                    double distance = 0;
+                    const pair<GeoCoord, GeoCoord>& trip = localTrips[next++ % localTrips.size()];
+                    mapRouter->generatePointToPointRoute(trip.first, trip.second, route, distance);
+                    g_sink += distance;
+                    tiledNodes = max(tiledNodes, tiledMap.snapshot()->nodeCount());
+                });
+            }
+            wholeNodes = snapshot->nodeCount();
+        }
+        filesystem::remove_all(tileDirectory);
+    }
+
+      // DeliveryOptimizer
+    DeliveryOptimizer optimizer(&sm);
+    const int optimizerSizes[] = { 10, 100, 1000 };
+    for (int n : optimizerSizes)
+    {
+        vector<DeliveryRequest> original = randomDeliveries(nodes, n, rng);
+        GeoCoord randomDepot = nodes[pick(rng)];
+        runner.run("DeliveryOptimizer/optimizeDeliveryOrder/N=" + to_string(n), [&]() {
+            vector<DeliveryRequest> deliveries = original;
+            double oldCrow, newCrow;
+            optimizer.optimizeDeliveryOrder(randomDepot, deliveries, oldCrow, newCrow);
+            g_sink += newCrow;
+        });
+    }
+
+      // Time windows: 300 stops with one-hour windows around the times a robot at 2 mph would reach them in an
+      // optimized order, shuffled and re-sequenced for a 3 mph robot
+    {
+        vector<DeliveryRequest> windowed = randomDeliveries(nodes, 300, rng);
+        GeoCoord randomDepot = nodes[pick(rng)];
+        double oldCrow, newCrow;
+        optimizer.optimizeDeliveryOrder(randomDepot, windowed, oldCrow, newCrow);
+        double time = 0;
+        GeoCoord prev = randomDepot;
+        uniform_real_distribution<double> offset(0, 1);
+        for (DeliveryRequest& delivery : windowed)
+        {
+            time += distanceEarthMiles(prev, delivery.location) / 2;
+            delivery.windowOpen = max(0.0, time - offset(rng));
+            delivery.windowClose = delivery.windowOpen + 1;
+            delivery.serviceTime = 0.05;
+            time += delivery.serviceTime;
+            prev = delivery.location;
+        }
+        shuffle(windowed.begin(), windowed.end(), rng);
+        runner.run("DeliveryOptimizer/optimizeDeliveryOrder/timeWindows/N=300", [&]() {
+            vector<DeliveryRequest> deliveries = windowed;
+            double crow = 0, returnTime = 0;
+            optimizer.optimizeDeliveryOrder(randomDepot, deliveries, 3, crow, returnTime);
+            g_sink += crow + returnTime;
+        });
+    }
+
+      // Multi-robot mode: 1000 deliveries over 10 robots of capacity 110
+    {
+        vector<DeliveryRequest> original = randomDeliveries(nodes, 1000, rng);
+        GeoCoord randomDepot = nodes[pick(rng)];
+        vector<int> capacities(10, 110);
+        runner.run("DeliveryOptimizer/optimizeFleet/N=1000,K=10", [&]() {
+            FleetPlan plan;
+            optimizer.optimizeFleet(randomDepot, original, capacities, plan);
+            g_sink += plan.totalCrowDistance;
+        }, 1, 3);
+    }
+
+      // DeliveryPlanner, end to end
+    DeliveryPlanner planner(&sm);
+    if (haveDeliveries)
+    {
+        runner.run("DeliveryPlanner/generateDeliveryPlan/" + deliveriesFile, [&]() {
+            vector<DeliveryCommand> commands;
+            double miles = 0;
+            planner.generateDeliveryPlan(depot, fileDeliveries, commands, miles);
+            g_sink += commands.size() + miles;
+        });
+    }
+    runner.run("DeliveryPlanner/generateDeliveryPlan/random/N=10", [&]() {
+        vector<DeliveryRequest> deliveries = randomDeliveries(nodes, 10, rng);
+        vector<DeliveryCommand> commands;
+        double miles = 0;
+        planner.generateDeliveryPlan(nodes[pick(rng)], deliveries, commands, miles);
+        g_sink += commands.size() + miles;
+    });
+      // Async: many plans in flight at once on the shared pool, none of them holding a thread while queued
+    if (haveDeliveries)
+    {
+        const int IN_FLIGHT = 1000;
+        runner.run("DeliveryPlanner/generateDeliveryPlanAsync/inFlight=" + to_string(IN_FLIGHT), [&]() {
+            latch allDone(IN_FLIGHT);
+            for (int i = 0; i < IN_FLIGHT; i++)
+                startTask(planner.generateDeliveryPlanAsync(depot, fileDeliveries), [&](PlanResult plan) {
+                    g_sink += plan.commands.size();
+                    allDone.count_down();
+                });
+            allDone.wait();
+        }, IN_FLIGHT, 3);
+    }
+
+      // Streaming: the same plan, but what the robot waits for is the first command
+    vector<double> firstCommandSeconds;
+    runner.run("DeliveryPlanner/generateDeliveryPlan/random/N=10/streamed", [&]() {
+        vector<DeliveryRequest> deliveries = randomDeliveries(nodes, 10, rng);
+        double miles = 0;
+        auto start = chrono::steady_clock::now();
+        bool first = true;
+        planner.generateDeliveryPlan(nodes[pick(rng)], deliveries, [&](const DeliveryCommand& cmd) {
+            if (first)
+                firstCommandSeconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+            first = false;
+            g_sink += cmd.streetName().size();
+        }, miles);
+        g_sink += miles;
+    });
+
+      // Command output: a 100-delivery plan as description() + endl, buffered text, and the binary encoding
+    vector<DeliveryCommand> plan;
+    double planMiles = 0;
+    GeoCoord planDepot = haveDeliveries ? depot : nodes[0];
+    vector<DeliveryRequest> reachable;      // Random map nodes the depot can reach, so the plan can't fail
+    for (int attempt = 0; attempt < 1000 && reachable.size() < 100; attempt++)
+    {
+        list<StreetSegment> route;
+        double distance;
+        const GeoCoord& gc = nodes[pick(rng)];
+        if (router.generatePointToPointRoute(planDepot, gc, route, distance) == DELIVERY_SUCCESS)
+            reachable.push_back(DeliveryRequest("item " + to_string(reachable.size()), gc));
+    }
+    planner.generateDeliveryPlan(planDepot, reachable, plan, planMiles);
+    size_t textBytes = 0, binaryBytes = 0;
+    if (!plan.empty())
+    {
+        int count = (int) plan.size();
+        ofstream devNull("/dev/null");
+        runner.run("DeliveryCommand/description+endl", [&]() {
+            for (const DeliveryCommand& cmd : plan)
+                devNull << cmd.description() << endl;
+        }, count);
+        runner.run("DeliveryCommand/appendCommandText", [&]() {
+            string text;
+            for (const DeliveryCommand& cmd : plan)
+                appendCommandText(cmd, text);
+            devNull.write(text.data(), text.size());
+            devNull.flush();
+            textBytes = text.size();
+        }, count);
+        string binary;
+        runner.run("DeliveryCommand/CommandEncoder::encode", [&]() {
+            binary.clear();
+            CommandEncoder encoder;
+            encoder.encode(plan, binary);
+            binaryBytes = binary.size();
+        }, count);
+        runner.run("DeliveryCommand/CommandDecoder::decode", [&]() {
+            vector<DeliveryCommand> decoded;
+            CommandDecoder decoder;
+            decoder.decode(binary, decoded);
+            g_sink += decoded.size();
+        }, count);
+    }
+
+      // Route geometry for the same plan's legs: as text coordinates (four per segment, as in the map file), as encoded
+      // polylines, and as polylines simplified to within 5 thousandths of a mile (about 8 m) of the roads
+    size_t segmentTextBytes = 0, polylineBytes = 0, simplifiedBytes = 0;
+    DeliveryPlan geometryPlan;
+    if (planner.generateDeliveryPlan(planDepot, reachable, geometryPlan) == DELIVERY_SUCCESS)
+    {
+        for (const list<StreetSegment>& leg : geometryPlan.legs)
+        {
+            for (const StreetSegment& seg : leg)
+                segmentTextBytes += seg.start.latitudeText.size() + seg.start.longitudeText.size()
+                                    + seg.end.latitudeText.size() + seg.end.longitudeText.size() + 4;
+        }
+        int segments = 0;
+        for (const list<StreetSegment>& leg : geometryPlan.legs)
+            segments += (int) leg.size();
+        auto encodeLegs = [&](double toleranceMiles) {
+            string encoded;
+            vector<GeoCoord> points;
+            for (const list<StreetSegment>& leg : geometryPlan.legs)
+            {
+                routeVertices(leg, points);
+                if (toleranceMiles > 0)
+                    simplifyPolyline(points, toleranceMiles, points);
+                appendPolyline(points, encoded);
+                encoded += '\n';
+            }
+            return encoded;
+        };
+        runner.run("Polyline/appendPolyline", [&]() {
+            polylineBytes = encodeLegs(0).size();
+        }, segments);
+        runner.run("Polyline/simplifyPolyline+appendPolyline/tolerance=0.005", [&]() {
+            simplifiedBytes = encodeLegs(0.005).size();
+        }, segments);
+        string encoded = encodeLegs(0);
+        runner.run("Polyline/decodePolyline", [&]() {
+            vector<GeoCoord> points;
+            size_t start = 0;
+            for (size_t end = encoded.find('\n'); end != string::npos; start = end + 1, end = encoded.find('\n', start))
+            {
+                decodePolyline(encoded.substr(start, end - start), points);
+                g_sink += points.size();
+            }
+        }, segments);
+    }
+
+      // A late order for a 30-delivery plan: re-planning all 31 deliveries, against inserting it into the plan
+      // (the insert's time includes copying the plan, so every iteration starts from the same one)
+    if (reachable.size() > 30)
+    {
+        vector<DeliveryRequest> planned(reachable.begin(), reachable.begin() + 30);
+        DeliveryPlan basePlan;
+        planner.generateDeliveryPlan(planDepot, planned, basePlan);
+        size_t nextLate = 30;
+        auto lateOrder = [&]() -> const DeliveryRequest& {
+            if (nextLate == reachable.size())
+                nextLate = 30;
+            return reachable[nextLate++];
+        };
+        runner.run("DeliveryPlanner/generateDeliveryPlan/replan/N=31", [&]() {
+            vector<DeliveryRequest> deliveries = planned;
+            deliveries.push_back(lateOrder());
+            vector<DeliveryCommand> commands;
+            double miles = 0;
+            planner.generateDeliveryPlan(planDepot, deliveries, commands, miles);
+            g_sink += commands.size() + miles;
+        });
+        runner.run("DeliveryPlanner/insertDelivery/N=30", [&]() {
+            DeliveryPlan plan = basePlan;
+            planner.insertDelivery(plan, lateOrder());
+            g_sink += plan.commands.size() + plan.totalDistanceTravelled;
+        });
+    }
+
+    if (!hashMapStats.empty())
+        cout << "\nExpandableHashMap<GeoCoord> stats:" << endl;
+    for (size_t i = 0; i < hashMapStats.size(); i++)
+        cout << "  " << hashMapStats[i] << endl;
+    if (textBytes > 0 && binaryBytes > 0)
+        cout << "\nCommand output for a " << plan.size() << "-command plan: " << textBytes << " bytes as text, "
+             << binaryBytes << " bytes binary" << endl;
+    if (segmentTextBytes > 0 && polylineBytes > 0 && simplifiedBytes > 0)
+        cout << "\nRoute geometry for the plan's " << geometryPlan.legs.size() << " legs: " << segmentTextBytes
+             << " bytes as segment text, " << polylineBytes << " bytes as polylines, " << simplifiedBytes
+             << " bytes simplified to 0.005 miles" << endl;
+    if (aggregate.queries > 0)
+        cout << "\nRouter search stats: " << aggregate << endl;
+    if (tiledNodes > 0)
+        cout << "\nTiled map: at most " << tiledNodes << " of " << wholeNodes << " nodes in memory at once" << endl;
+    if (!searchStats.empty())
+    {
+        cout << "\nRouteSearch nodes expanded:" << endl;
+        for (const string& line : searchStats)
+            cout << "  " << line << endl;
+    }
+    if (!nearEdgeShares.empty())
+    {
+        cout << "\nEdges between nodes less than 64 ids apart:";
+        for (const string& share : nearEdgeShares)
+            cout << "  " << share;
+        cout << endl;
+    }
+    if (!firstCommandSeconds.empty())
+    {
+        sort(firstCommandSeconds.begin(), firstCommandSeconds.end());
+        cout << "\nStreamed plans: median time to first command " << firstCommandSeconds[firstCommandSeconds.size() / 2] * 1000
+             << " ms over " << firstCommandSeconds.size() << " plans" << endl;
+    }
+    if (noRoute > 0)
+        cout << "\n" << noRoute << " random point-to-point queries had no route" << endl;
+    return g_sink < 0 ? 1 : 0;      // Never true; keeps g_sink observable
+}
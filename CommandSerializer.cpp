@@ -0,0 +1,266 @@
+// CommandSerializer.cpp
+// The binary and text command encodings described in CommandSerializer.h
+
+#include "CommandSerializer.h"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+namespace
+{
+    const char HEADER[4] = { 'D', 'C', 'B', '1' };
+
+    enum Kind { KIND_INVALID = 0, KIND_PROCEED = 1, KIND_TURN = 2, KIND_DELIVER = 3 };
+
+    const double DISTANCE_UNITS_PER_MILE = 10000;
+
+      // Direction codes 0-9; OTHER_DIRECTION means the direction follows as a string
+    const char* const DIRECTIONS[] = {
+        "east", "northeast", "north", "northwest", "west", "southwest", "south", "southeast", "left", "right"
+    };
+    const int DIRECTION_COUNT = sizeof(DIRECTIONS) / sizeof(DIRECTIONS[0]);
+    const int OTHER_DIRECTION = 63;
+
+    int directionCode(const string& direction)
+    {
+        for (int i = 0; i < DIRECTION_COUNT; i++)
+        {
+            if (direction == DIRECTIONS[i])
+                return i;
+        }
+        return OTHER_DIRECTION;
+    }
+
+    void putVarint(uint64_t value, string& out)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((char) (value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((char) value);
+    }
+
+      // Returns false if [pos, end) ends before the varint does (or it is absurdly long)
+    bool getVarint(const char*& pos, const char* end, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos == end)
+                return false;
+            uint8_t byte = (uint8_t) *pos++;
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+}
+
+CommandEncoder::CommandEncoder()
+ : m_wroteHeader(false), m_nextStringId(0), m_lastStringId(-1)
+{
+}
+
+void CommandEncoder::encode(const DeliveryCommand& cmd, string& out)
+{
+    if (!m_wroteHeader)
+    {
+        out.append(HEADER, sizeof(HEADER));
+        m_wroteHeader = true;
+    }
+
+    int kind = cmd.isProceed() ? KIND_PROCEED : cmd.isTurn() ? KIND_TURN : cmd.isDeliver() ? KIND_DELIVER : KIND_INVALID;
+    int direction = (kind == KIND_PROCEED || kind == KIND_TURN) ? directionCode(cmd.direction()) : 0;
+    out.push_back((char) (kind << 6 | direction));
+    if (direction == OTHER_DIRECTION)
+        encodeString(cmd.direction(), out);
+
+    switch (kind)
+    {
+      case KIND_PROCEED:
+        encodeString(cmd.street(), out);
+        putVarint((uint64_t) llround(max(0.0, cmd.distance()) * DISTANCE_UNITS_PER_MILE), out);
+        break;
+      case KIND_TURN:
+        encodeString(cmd.street(), out);
+        break;
+      case KIND_DELIVER:
+        encodeString(cmd.item(), out);
+        break;
+    }
+}
+
+void CommandEncoder::encode(const vector<DeliveryCommand>& commands, string& out)
+{
+    for (const DeliveryCommand& cmd : commands)
+        encode(cmd, out);
+}
+
+void CommandEncoder::encodeString(const string& s, string& out)
+{
+      // A Turn and the Proceed after it name the same street, so check the last string before hashing
+    if (m_lastStringId >= 0 && s == m_lastString)
+    {
+        putVarint((uint64_t) m_lastStringId + 1, out);
+        return;
+    }
+    const int* id = m_stringIds.find(s);
+    m_lastString = s;
+    if (id != nullptr)
+    {
+        m_lastStringId = *id;
+        putVarint((uint64_t) *id + 1, out);
+        return;
+    }
+    m_lastStringId = m_nextStringId;
+    m_stringIds.associate(s, m_nextStringId++);
+    putVarint(0, out);
+    putVarint(s.size(), out);
+    out.append(s);
+}
+
+CommandDecoder::CommandDecoder()
+ : m_readHeader(false), m_failed(false)
+{
+}
+
+bool CommandDecoder::decode(const char*& pos, const char* end, DeliveryCommand& cmd)
+{
+    if (m_failed)
+        return false;
+    const char* p = pos;
+    if (!m_readHeader)
+    {
+        if (end - p < (ptrdiff_t) sizeof(HEADER))
+            return false;
+        if (memcmp(p, HEADER, sizeof(HEADER)) != 0)
+        {
+            m_failed = true;
+            return false;
+        }
+        p += sizeof(HEADER);
+    }
+    if (p == end)
+        return false;
+
+      // Strings interned by a record that turns out to be incomplete are forgotten again
+    size_t knownStrings = m_strings.size();
+    auto incomplete = [&]() {
+        m_strings.resize(knownStrings);
+        return false;
+    };
+
+    uint8_t opcode = (uint8_t) *p++;
+    int kind = opcode >> 6;
+    int direction = opcode & 0x3f;
+    const string* directionText = nullptr;
+    if (direction == OTHER_DIRECTION)
+    {
+        if (!decodeString(p, end, directionText))
+            return incomplete();
+    }
+    else if (direction >= DIRECTION_COUNT)
+    {
+        m_failed = true;
+        return false;
+    }
+    string dir = (directionText != nullptr) ? *directionText : DIRECTIONS[direction];
+
+    const string* text = nullptr;
+    uint64_t distance = 0;
+    switch (kind)
+    {
+      case KIND_PROCEED:
+        if (!decodeString(p, end, text) || !getVarint(p, end, distance))
+            return incomplete();
+        cmd.initAsProceedCommand(dir, *text, distance / DISTANCE_UNITS_PER_MILE);
+        break;
+      case KIND_TURN:
+        if (!decodeString(p, end, text))
+            return incomplete();
+        cmd.initAsTurnCommand(dir, *text);
+        break;
+      case KIND_DELIVER:
+        if (!decodeString(p, end, text))
+            return incomplete();
+        cmd.initAsDeliverCommand(*text);
+        break;
+      default:
+        cmd = DeliveryCommand();
+        break;
+    }
+    if (m_failed)
+        return false;
+    m_readHeader = true;
+    pos = p;
+    return true;
+}
+
+bool CommandDecoder::decode(const string& data, vector<DeliveryCommand>& commands)
+{
+    const char* pos = data.data();
+    const char* end = pos + data.size();
+    DeliveryCommand cmd;
+    while (decode(pos, end, cmd))
+        commands.push_back(cmd);
+    return !m_failed && pos == end;
+}
+
+bool CommandDecoder::decodeString(const char*& pos, const char* end, const string*& s)
+{
+    uint64_t ref;
+    if (!getVarint(pos, end, ref))
+        return false;
+    if (ref > 0)
+    {
+        if (ref > m_strings.size())
+        {
+            m_failed = true;
+            return false;
+        }
+        s = &m_strings[ref - 1];
+        return true;
+    }
+    uint64_t length;
+    if (!getVarint(pos, end, length) || (uint64_t) (end - pos) < length)
+        return false;
+    m_strings.push_back(string(pos, (size_t) length));
+    pos += length;
+    s = &m_strings.back();
+    return true;
+}
+
+void appendCommandText(const DeliveryCommand& cmd, string& out)
+{
+    if (cmd.isTurn())
+    {
+        out.append("Turn ");
+        out.append(cmd.direction());
+        out.append(" on ");
+        out.append(cmd.street());
+    }
+    else if (cmd.isProceed())
+    {
+        out.append("Proceed ");
+        out.append(cmd.direction());
+        out.append(" on ");
+        out.append(cmd.street());
+        out.append(" for ");
+        char number[64];
+        to_chars_result result = to_chars(number, number + sizeof(number), cmd.distance(), chars_format::fixed, 2);
+        out.append(number, result.ptr);
+        out.append(" miles");
+    }
+    else if (cmd.isDeliver())
+    {
+        out.append("DELIVER ");
+        out.append(cmd.item());
+    }
+    else
+        out.append("<invalid>");
+    out.push_back('\n');
+}
@@ -0,0 +1,66 @@
+// CommandSerializer.h
+// Compact encodings of DeliveryCommands, for sending plans to robots and logging them.
+//
+// Binary: a 4-byte header ("DCB1") and then one record per command:
+//   opcode byte     command kind in the top two bits, direction code in the low six
+//   string ref      PROCEED/TURN: the street; DELIVER: the item
+//   distance        PROCEED only: miles in units of 1/10000 mile, as a varint
+// A string ref is a varint: 0 introduces a new string (varint length, then its bytes), which takes the next id;
+// id + 1 repeats an earlier one. Strings are interned as they first appear, so the format streams: an encoder can
+// send each leg's commands as they are planned (DeliveryPlanner's streaming overload) and a decoder can consume
+// them as they arrive. Directions other than the eight compass points and left/right go in as strings too.
+// Decoded distances are within 1/20000 mile of the original; descriptions match except exactly at a rounding tie.
+//
+// Text: appendCommandText appends exactly description() plus a newline to a string, without building an
+// ostringstream per command, so a whole plan can be written to a stream in one go instead of flushing every line.
+
+#ifndef COMMANDSERIALIZER_INCLUDED
+#define COMMANDSERIALIZER_INCLUDED
+
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class CommandEncoder
+{
+  public:
+    CommandEncoder();
+      // Appends cmd's record to out (after the header, the first time)
+    void encode(const DeliveryCommand& cmd, std::string& out);
+    void encode(const std::vector<DeliveryCommand>& commands, std::string& out);
+
+  private:
+    void encodeString(const std::string& s, std::string& out);
+
+    bool m_wroteHeader;
+    ExpandableHashMap<std::string, int> m_stringIds;
+    int m_nextStringId;
+    std::string m_lastString;   // The most recently encoded string, and its id (-1 before the first)
+    int m_lastStringId;
+};
+
+class CommandDecoder
+{
+  public:
+    CommandDecoder();
+      // Decodes the next command from [pos, end) into cmd and advances pos past it. Returns false, leaving pos where
+      // it was, if the data holds no complete command yet (or is not a command stream at all; see failed()).
+    bool decode(const char*& pos, const char* end, DeliveryCommand& cmd);
+      // Decodes every complete command in data, appending them to commands; returns false if data was malformed
+    bool decode(const std::string& data, std::vector<DeliveryCommand>& commands);
+    bool failed() const { return m_failed; }
+
+  private:
+    bool decodeString(const char*& pos, const char* end, const std::string*& s);
+
+    bool m_readHeader;
+    bool m_failed;
+    std::vector<std::string> m_strings;
+};
+
+  // Appends cmd.description() and a newline to out
+void appendCommandText(const DeliveryCommand& cmd, std::string& out);
+
+#endif // COMMANDSERIALIZER_INCLUDED
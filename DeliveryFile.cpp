@@ -0,0 +1,158 @@
+// DeliveryFile.cpp
+// The memory-mapped delivery file reader declared in DeliveryFile.h
+
+#include "DeliveryFile.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace
+{
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+      // Finds the next whitespace-separated token in [pos, end), as istream's >> would; returns false if there is none
+    bool nextToken(const char*& pos, const char* end, const char*& token, size_t& length)
+    {
+        while (pos != end && isSpace(*pos))
+            pos++;
+        if (pos == end)
+            return false;
+        token = pos;
+        while (pos != end && !isSpace(*pos))
+            pos++;
+        length = pos - token;
+        return true;
+    }
+
+      // Sets gc from latitude and longitude tokens, keeping their text exactly as written (GeoCoords hash by text)
+    bool setCoord(GeoCoord& gc, const char* lat, size_t latLength, const char* lon, size_t lonLength)
+    {
+        double latitude, longitude;
+        if (from_chars(lat, lat + latLength, latitude).ec != errc() || from_chars(lon, lon + lonLength, longitude).ec != errc())
+            return false;
+        gc.latitudeText.assign(lat, latLength);
+        gc.longitudeText.assign(lon, lonLength);
+        gc.latitude = latitude;
+        gc.longitude = longitude;
+        return true;
+    }
+}
+
+DeliveryFileReader::DeliveryFileReader(const string& path, ostream* diagnostics)
+ : m_isOpen(false), m_diagnostics(diagnostics), m_mapping(nullptr), m_mappingSize(0), m_next(nullptr), m_end(nullptr)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        m_mappingSize = (size_t) info.st_size;
+        m_mapping = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_mapping == MAP_FAILED)
+            m_mapping = nullptr;
+        else
+        {
+            madvise(m_mapping, m_mappingSize, MADV_SEQUENTIAL);
+            m_next = static_cast<const char*>(m_mapping);
+            m_end = m_next + m_mappingSize;
+        }
+    }
+    close(fd);
+    if (m_mapping == nullptr && m_mappingSize != 0)
+        return;
+#else
+    ifstream inf(path, ios::binary);
+    if (!inf)
+        return;
+    m_buffer.assign(istreambuf_iterator<char>(inf), istreambuf_iterator<char>());
+    m_next = m_buffer.data();
+    m_end = m_next + m_buffer.size();
+#endif
+
+      // The depot: the first two tokens (wherever they are), then the rest of that line is ignored
+    const char *lat, *lon;
+    size_t latLength, lonLength;
+    const char* pos = m_next;
+    if (!nextToken(pos, m_end, lat, latLength) || !nextToken(pos, m_end, lon, lonLength) ||
+        !setCoord(m_depot, lat, latLength, lon, lonLength))
+        return;
+    const char* newline = static_cast<const char*>(memchr(pos, '\n', m_end - pos));
+    m_next = (newline == nullptr) ? m_end : newline + 1;
+    m_isOpen = true;
+}
+
+DeliveryFileReader::~DeliveryFileReader()
+{
+#ifndef _WIN32
+    if (m_mapping != nullptr)
+        munmap(m_mapping, m_mappingSize);
+#endif
+}
+
+bool DeliveryFileReader::next(DeliveryRequest& request)
+{
+    while (m_isOpen && m_next != m_end)
+    {
+        const char* line = m_next;
+        const char* newline = static_cast<const char*>(memchr(line, '\n', m_end - line));
+        const char* lineEnd = (newline == nullptr) ? m_end : newline;
+        m_next = (newline == nullptr) ? m_end : newline + 1;
+        if (parseLine(line, lineEnd, request))
+            return true;
+    }
+    return false;
+}
+
+bool DeliveryFileReader::parseLine(const char* line, const char* end, DeliveryRequest& request)
+{
+    const char* colon = static_cast<const char*>(memchr(line, ':', end - line));
+    if (colon == nullptr)
+    {
+        if (m_diagnostics != nullptr)
+            *m_diagnostics << "Missing colon in deliveries file line: " << string(line, end) << endl;
+        return false;
+    }
+    const char *lat, *lon;
+    size_t latLength, lonLength;
+    const char* pos = line;
+    if (!nextToken(pos, colon, lat, latLength) || !nextToken(pos, colon, lon, lonLength) ||
+        !setCoord(request.location, lat, latLength, lon, lonLength))
+    {
+        if (m_diagnostics != nullptr)
+            *m_diagnostics << "Bad format in deliveries file line: " << string(line, end) << endl;
+        return false;
+    }
+    if (colon + 1 == end)
+    {
+        if (m_diagnostics != nullptr)
+            *m_diagnostics << "Missing item in deliveries file line: " << string(line, end) << endl;
+        return false;
+    }
+    request.item.assign(colon + 1, end);
+    return true;
+}
+
+bool loadDeliveryFile(const string& path, GeoCoord& depot, vector<DeliveryRequest>& deliveries, ostream* diagnostics)
+{
+    DeliveryFileReader reader(path, diagnostics);
+    if (!reader.isOpen())
+        return false;
+    depot = reader.depot();
+    DeliveryRequest request("", GeoCoord());
+    while (reader.next(request))
+        deliveries.push_back(request);
+    return true;
+}
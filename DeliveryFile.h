@@ -0,0 +1,57 @@
+// DeliveryFile.h
+// A streaming reader for delivery request files: the depot's coordinates on the first line, then one
+// "latitude longitude:item" line per delivery.
+//
+//   DeliveryFileReader reader("deliveries.txt", &cout);
+//   DeliveryRequest request("", GeoCoord());
+//   while (reader.next(request))
+//       ...
+//
+// The file is memory-mapped and scanned in place; coordinates are converted with from_chars, and next() reuses the
+// request's strings, so reading even very large files allocates next to nothing per delivery. Malformed lines are
+// reported to the diagnostics stream (if any) and skipped, with the same messages main.cpp has always printed.
+
+#ifndef DELIVERYFILE_INCLUDED
+#define DELIVERYFILE_INCLUDED
+
+#include "provided.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class DeliveryFileReader
+{
+  public:
+    DeliveryFileReader(const std::string& path, std::ostream* diagnostics = nullptr);
+    ~DeliveryFileReader();
+
+      // False if the file could not be opened or has no depot line
+    bool isOpen() const { return m_isOpen; }
+    const GeoCoord& depot() const { return m_depot; }
+
+      // Reads the next well-formed delivery into request; returns false at the end of the file
+    bool next(DeliveryRequest& request);
+
+    DeliveryFileReader(const DeliveryFileReader&) = delete;
+    DeliveryFileReader& operator=(const DeliveryFileReader&) = delete;
+
+  private:
+      // Parses one delivery line (without its newline) into request, reporting it if malformed
+    bool parseLine(const char* line, const char* end, DeliveryRequest& request);
+
+    bool m_isOpen;
+    GeoCoord m_depot;
+    std::ostream* m_diagnostics;
+    void* m_mapping;            // The mapped file, or nullptr if it is empty (or was read into m_buffer instead)
+    size_t m_mappingSize;
+    std::string m_buffer;       // The file's contents where memory mapping isn't available
+    const char* m_next;         // Start of the next unread line
+    const char* m_end;
+};
+
+  // Reads a whole delivery file (the depot and every well-formed delivery); returns false if it can't be opened
+bool loadDeliveryFile(const std::string& path, GeoCoord& depot, std::vector<DeliveryRequest>& deliveries,
+                      std::ostream* diagnostics = nullptr);
+
+#endif // DELIVERYFILE_INCLUDED
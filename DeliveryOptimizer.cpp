@@ -1,6 +1,12 @@
 #include "provided.h"
+#include "FleetPlan.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
 #include <vector>
-#include <set>
 using namespace std;
 
 class DeliveryOptimizerImpl
@@ -13,10 +19,232 @@ class DeliveryOptimizerImpl
         vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+    bool optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double milesPerHour,
+        double& newCrowDistance,
+        double& returnTime) const;
+    bool optimizeFleet(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        const vector<int>& capacities,
+        FleetPlan& plan,
+        double balanceWeight) const;
   private:
     const StreetMap* m_streetMap;        // Pointer to a fully-constructed and loaded StreetMap object
+    
+    static constexpr int MAX_STARTS = 16;           // Tours tried by the multi-start search
+    static constexpr int NEIGHBOURS = 10;           // Candidate neighbours per location for 2-opt
+    static constexpr int MAX_TWO_OPT_PASSES = 100;
+    static constexpr int MAX_FLEET_ROUNDS = 10;     // Alternations of inter-route moves and per-route 2-opt
+    static constexpr int MAX_SEGMENT = 3;           // Longest run of deliveries moved at once by Or-opt
+    
+    static constexpr int MAX_DENSE_LOCATIONS = 2048;    // Above this, crow distances are computed on demand
+    
+      // Crow distances between the depot (location 0) and the deliveries (locations 1..n), and each location's
+      // nearest neighbours, computed once and shared by every start. Up to MAX_DENSE_LOCATIONS locations the
+      // distances are a table (32 MB at most); beyond that each is computed when asked for, and the neighbours come
+      // from a grid over the locations rather than from comparing every pair, so memory stays O(n).
+      // The depot and deliveries must outlive it.
+    class CrowDistances
+    {
+      public:
+        CrowDistances(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries);
+        int deliveryCount() const { return m_count - 1; }
+        double operator()(int from, int to) const
+        {
+            if (m_distances.empty())
+                return distanceEarthMiles(*m_locations[from], *m_locations[to]);
+            return m_distances[(size_t) from * m_count + to];
+        }
+        const vector<int>& neighbours(int location) const { return m_neighbours[location]; }
+        bool onDemand() const { return m_distances.empty(); }
+          // With on-demand distances, the deliveries in a sweep over the grid (row by row, alternating direction),
+          // so that deliveries next to each other in it are close; empty otherwise
+        const vector<int>& sweep() const { return m_sweep; }
+      private:
+        int m_count;
+        vector<const GeoCoord*> m_locations;
+        vector<double> m_distances;
+        vector<vector<int>> m_neighbours;   // Deliveries only (never the depot), nearest first
+        vector<int> m_sweep;
+        
+        void gridNeighbours();
+    };
+    
+      // Returns a tour of location indices, starting and ending at the depot (0)
+    vector<int> nearestNeighbourTour(const CrowDistances& dist, int first) const;
+    double improveWithTwoOpt(const CrowDistances& dist, vector<int>& tour) const;
+    
+      // Time-window mode. Location 0 is the depot: open from time 0 with no closing time or service time.
+    struct Timing
+    {
+        vector<double> open, close, service;
+        double milesPerHour;
+        double travel(const CrowDistances& dist, int from, int to) const { return dist(from, to) / milesPerHour; }
+    };
+    
+      // A tour's schedule, by position: the earliest each stop's service can start (forward from the depot), and the
+      // latest it can start with every later stop still served in its window (backward from the return). A run of
+      // stops fits between positions a and a+1 if, starting from earliest[a], it keeps to its own windows and reaches
+      // tour[a+1] by latest[a+1]: O(1) per candidate move. Returns false if the tour misses a window.
+    static bool schedule(const CrowDistances& dist, const Timing& timing, const vector<int>& tour, vector<double>& earliest, vector<double>& latest);
+    static bool fits(const CrowDistances& dist, const Timing& timing, const vector<int>& tour, const vector<double>& earliest,
+                     const vector<double>& latest, int a, const int* run, int runLength);
+      // The gaps (a, a+1) worth trying for location: earliest and latest only grow along a tour, so gaps outside
+      // [first, last] start too late for its window to close or end before it opens
+    static void candidateGaps(const Timing& timing, const vector<double>& earliest, const vector<double>& latest, int location, int& first, int& last);
+      // Inserts the deliveries one at a time where each adds the least distance and fits: in the given order, or if
+      // mostConstrainedFirst, always the delivery with the fewest gaps it fits in. Returns an empty tour if a
+      // delivery fits nowhere.
+    vector<int> timedInsertionTour(const CrowDistances& dist, const Timing& timing, const vector<int>& order, bool mostConstrainedFirst) const;
+      // Or-opt: moves runs of up to MAX_SEGMENT deliveries elsewhere in the tour while that is shorter and still fits
+    void improveWithOrOpt(const CrowDistances& dist, const Timing& timing, vector<int>& tour) const;
+    static double tourLength(const CrowDistances& dist, const vector<int>& tour);
+    
+      // One tour per robot in the multi-robot mode: its deliveries (locations 1..n, without the depot) in order
+    struct FleetRoutes
+    {
+        vector<vector<int>> stops;
+        vector<int> capacity;
+        vector<double> length;      // Crow distance depot -> stops -> depot
+        vector<int> routeOf;        // For each location, its route and position in that route
+        vector<int> positionOf;
+    };
+    
+      // Clarke-Wright savings: starting from one route per delivery, joins route ends in order of decreasing savings
+      // d(0,i) + d(0,j) - d(i,j) while the joined route has at most capacity deliveries
+    vector<vector<int>> savingsRoutes(const CrowDistances& dist, int capacity) const;
+      // Cuts the routes down to one per robot and gives each robot a route it has the capacity for
+    FleetRoutes assignRobots(const CrowDistances& dist, vector<vector<int>> routes, const vector<int>& capacities) const;
+      // Relocate and swap moves between routes, minimizing total + balanceWeight * longest crow distance.
+      // Returns true if any move was made.
+    bool improveBetweenRoutes(const CrowDistances& dist, FleetRoutes& fleet, double balanceWeight) const;
+      // 2-opt within each route, the routes in parallel
+    void improveEachRoute(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries, const CrowDistances& dist, FleetRoutes& fleet) const;
+    
+      // Inserts location where it adds the least distance, in a route with fewer stops than its capacity
+    static void insertCheapest(const CrowDistances& dist, vector<vector<int>>& routes, const vector<int>& capacity, int location);
+      // Recomputes route's length and its locations' routeOf/positionOf
+    static void refresh(const CrowDistances& dist, FleetRoutes& fleet, int route);
 };
 
+DeliveryOptimizerImpl::CrowDistances::CrowDistances(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+ : m_count((int) deliveries.size() + 1), m_neighbours(m_count)
+{
+    m_locations.push_back(&depot);
+    for (const DeliveryRequest& delivery : deliveries)
+        m_locations.push_back(&delivery.location);
+    if (m_count > MAX_DENSE_LOCATIONS)
+    {
+        gridNeighbours();
+        return;
+    }
+    
+    m_distances.resize((size_t) m_count * m_count);
+    ThreadPool::shared().parallelFor(m_count, [&](size_t from) {
+        for (int to = 0; to < m_count; to++)
+            m_distances[from * m_count + to] = distanceEarthMiles(*m_locations[from], *m_locations[to]);
+        
+        vector<int>& nearest = m_neighbours[from];
+        for (int to = 1; to < m_count; to++)
+        {
+            if (to != (int) from)
+                nearest.push_back(to);
+        }
+        size_t keep = min(nearest.size(), (size_t) NEIGHBOURS);
+        auto closer = [&](int x, int y) { return m_distances[from * m_count + x] < m_distances[from * m_count + y]; };
+        partial_sort(nearest.begin(), nearest.begin() + keep, nearest.end(), closer);
+        nearest.resize(keep);
+    });
+}
+
+  // Buckets the locations into a square grid of about two per cell, then searches each location's cell and the
+  // rings of cells around it, outward, until no unsearched cell can hold anything nearer than the NEIGHBOURS found
+void DeliveryOptimizerImpl::CrowDistances::gridNeighbours()
+{
+    double minLat = m_locations[0]->latitude, maxLat = minLat;
+    double minLon = m_locations[0]->longitude, maxLon = minLon;
+    for (const GeoCoord* g : m_locations)
+    {
+        minLat = min(minLat, g->latitude);
+        maxLat = max(maxLat, g->latitude);
+        minLon = min(minLon, g->longitude);
+        maxLon = max(maxLon, g->longitude);
+    }
+    int side = max(1, (int) sqrt(m_count / 2.0));
+    double cellLat = max((maxLat - minLat) / side, 1e-9);
+    double cellLon = max((maxLon - minLon) / side, 1e-9);
+    auto rowOf = [&](int i) { return min(side - 1, (int) ((m_locations[i]->latitude - minLat) / cellLat)); };
+    auto colOf = [&](int i) { return min(side - 1, (int) ((m_locations[i]->longitude - minLon) / cellLon)); };
+    
+      // CSR buckets: cell c holds locations cellItems[cellStart[c], cellStart[c+1]), in index order
+    vector<int> cellStart(side * side + 1, 0);
+    for (int i = 0; i < m_count; i++)
+        cellStart[rowOf(i) * side + colOf(i) + 1]++;
+    for (int c = 0; c < side * side; c++)
+        cellStart[c + 1] += cellStart[c];
+    vector<int> cellItems(m_count);
+    vector<int> next(cellStart.begin(), cellStart.end() - 1);
+    for (int i = 0; i < m_count; i++)
+        cellItems[next[rowOf(i) * side + colOf(i)]++] = i;
+    
+      // Anything beyond ring r is at least r cells away in latitude or longitude. (Slightly understated, so the
+      // search errs on the side of looking further.)
+    const double MILES_PER_DEGREE = deg2rad(1) * 6371.0 / 1.609344;
+    double widestLat = max(fabs(minLat), fabs(maxLat));
+    double cellMiles = 0.99 * MILES_PER_DEGREE * min(cellLat, cellLon * cos(deg2rad(min(widestLat, 89.0))));
+    
+    ThreadPool::shared().parallelFor(m_count, [&](size_t from) {
+        int row = rowOf((int) from);
+        int col = colOf((int) from);
+        vector<pair<double, int>> found;    // (distance, location), nearest first, at most NEIGHBOURS
+        for (int r = 0; r < side; r++)
+        {
+            for (int y = max(0, row - r); y <= min(side - 1, row + r); y++)
+            {
+                  // Only the ring's outline: whole rows at its top and bottom, the two end cells in between
+                int step = (y == row - r || y == row + r) ? 1 : 2 * r;
+                for (int x = col - r; x <= col + r; x += max(step, 1))
+                {
+                    if (x < 0 || x >= side)
+                        continue;
+                    for (int k = cellStart[y * side + x]; k < cellStart[y * side + x + 1]; k++)
+                    {
+                        int to = cellItems[k];
+                        if (to == 0 || to == (int) from)
+                            continue;
+                        pair<double, int> candidate(distanceEarthMiles(*m_locations[from], *m_locations[to]), to);
+                        if (found.size() == (size_t) NEIGHBOURS && !(candidate < found.back()))
+                            continue;
+                        found.insert(upper_bound(found.begin(), found.end(), candidate), candidate);
+                        if (found.size() > (size_t) NEIGHBOURS)
+                            found.pop_back();
+                    }
+                }
+            }
+            if (found.size() == (size_t) NEIGHBOURS && found.back().first <= r * cellMiles)
+                break;
+        }
+        for (const pair<double, int>& neighbour : found)
+            m_neighbours[from].push_back(neighbour.second);
+    });
+    
+    for (int y = 0; y < side; y++)
+    {
+        for (int i = 0; i < side; i++)
+        {
+            int x = (y % 2 == 0) ? i : side - 1 - i;
+            for (int k = cellStart[y * side + x]; k < cellStart[y * side + x + 1]; k++)
+            {
+                if (cellItems[k] != 0)
+                    m_sweep.push_back(cellItems[k]);
+            }
+        }
+    }
+}
+
 DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm)
 {
     m_streetMap = sm;   // Fully-constructed and loaded StreetMap object
@@ -32,6 +260,7 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     double& oldCrowDistance,
     double& newCrowDistance) const
 {
+    TRACE_SCOPE("DeliveryOptimizer::optimizeDeliveryOrder");
       // Reset old and new crow distances to 0
     oldCrowDistance = 0;
     newCrowDistance = 0;
@@ -48,53 +277,47 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     oldCrowDistance += distanceEarthMiles(prev, depot);     // Add distance from final delivery back to depot
     
       /* Attempt to optimize the delivery order in some way (how is up to you), placing the (possibly) re-ordered deliveries back into the deliveries vector, to reduce the overall travel distance. For instance, if you had a bunch of deliveries that were geographically close to each other, you could place those close to each other in your vector */
-    /*
-      //IDEA: Find distances from point A to all other points. Prioritize based on distance
-    vector<DeliveryRequest> optimizedDeliveries;
-    set<DeliveryRequest> alreadyPlanned;        // Holds delivery requests that have already been optimized
-    prev = depot;           // Reset prev to our starting location, the depot
-
-      // Compare each delivery by distance from the prev location
-    
-      // If this is the first delivery we are checking, no need to check against min
-    double currentMin = distanceEarthMiles(prev, deliveries[0].location);
-    DeliveryRequest* nearestDelivery = &deliveries[0];
-    
-    for (vector<DeliveryRequest>::iterator start = deliveries.begin(); start != deliveries.end(); start++)
+      // Multi-start local search: build a nearest-neighbour tour starting from each of several different first
+      // deliveries, improve each with 2-opt, and keep the best. The starts are independent, so they run in parallel.
+    newCrowDistance = oldCrowDistance;
+    for (const DeliveryRequest& delivery : deliveries)
     {
-        for (vector<DeliveryRequest>::iterator end = deliveries.begin(); end != deliveries.end(); end++)
+        if (delivery.hasTiming())
         {
-              // If we are comparing a delivery to itself, it is meaningless, so skip
-            if (start == end)
-                continue;
-            
-            bool hasBeenPlanned = (alreadyPlanned.count(*end) == 1);
-              // If this delivery is closer than the currentMin and has not been planned...
-            if (distanceEarthMiles(prev, end->location) < currentMin && !hasBeenPlanned)
-            {
-                  // Update the currentMin and nearestDelivery
-                currentMin = distanceEarthMiles(prev, end->location);
-                nearestDelivery = &(*end);
-            }
+            double returnTime;
+            if (!optimizeDeliveryOrder(depot, deliveries, DeliveryOptimizer::DEFAULT_MILES_PER_HOUR, newCrowDistance, returnTime))
+                newCrowDistance = oldCrowDistance;      // No order meets every window; keep the one we were given
+            return;
         }
-        
-        optimizedDeliveries.push_back(*nearestDelivery);        // Add the nearest delivery
-        newCrowDistance += distanceEarthMiles(prev, nearestDelivery->location); // Update newCrosDistance
-        alreadyPlanned.insert(*nearestDelivery);        // Insert into alreadyPlanned
-        prev = nearestDelivery->location;       // Update prev GeoCoord
-        
     }
+    int n = (int) deliveries.size();
+    if (n < 3)
+        return;     // Two deliveries cost the same crow distance in either order
     
-      // Now the only movement left is from the final delivery location back to the depot
-    newCrowDistance += distanceEarthMiles(prev, depot);
+    CrowDistances dist(depot, deliveries);
+    int startCount = min(n, MAX_STARTS);
+    vector<vector<int>> tours(startCount);
+    vector<double> lengths(startCount);
+    ThreadPool::shared().parallelFor(startCount, [&](size_t k) {
+          // Spread the first deliveries over the whole list rather than taking the first few
+        int first = 1 + (int) (k * n / startCount);
+        tours[k] = nearestNeighbourTour(dist, first);
+        lengths[k] = improveWithTwoOpt(dist, tours[k]);
+    });
     
+    size_t best = min_element(lengths.begin(), lengths.end()) - lengths.begin();
+    if (lengths[best] >= oldCrowDistance)
+        return;     // Keep the original order unless we actually found something shorter
+    
+    vector<DeliveryRequest> optimizedDeliveries;
+    optimizedDeliveries.reserve(n);
+    for (int i = 1; i <= n; i++)
+        optimizedDeliveries.push_back(deliveries[tours[best][i] - 1]);
     deliveries = optimizedDeliveries;       // Update deliveries to our finalized deliveries
     
-    */
-      // After (optionally) re-ordering the delivery locations to optimize for travel distance,
-      // compute the new crow's distance, in miles, for your newly-proposed delivery ordering
-      // Determine the old crow's distance in miles from the depot to each of the successive delivery coordinates
-      // in their initial order, and then back to the depot.
+      // After re-ordering the delivery locations to optimize for travel distance, compute the new crow's distance,
+      // in miles, for the newly-proposed delivery ordering
+    newCrowDistance = 0;
     prev = depot;
     for (vector<DeliveryRequest>::iterator itr = deliveries.begin(); itr != deliveries.end(); itr++)
     {
@@ -105,6 +328,706 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     newCrowDistance += distanceEarthMiles(prev, depot);     // Add distance from final delivery back to depot
 }
 
+  // Builds a tour that starts at the depot, goes to delivery first, then always on to the nearest unvisited delivery
+vector<int> DeliveryOptimizerImpl::nearestNeighbourTour(const CrowDistances& dist, int first) const
+{
+    int n = dist.deliveryCount();
+    vector<bool> visited(n + 1, false);
+    vector<int> tour;
+    tour.reserve(n + 2);
+    tour.push_back(0);
+    tour.push_back(first);
+    visited[first] = true;
+    size_t sweepPosition = 0;
+    for (int step = 1; step < n; step++)
+    {
+        int curr = tour.back();
+        int nearest = -1;
+        if (dist.onDemand())
+        {
+              // Scanning every delivery each step would take O(n^2) distance computations. Take the nearest
+              // unvisited neighbour instead, or when all of them are visited, the next unvisited delivery in the sweep.
+            for (int next : dist.neighbours(curr))
+            {
+                if (!visited[next])
+                {
+                    nearest = next;
+                    break;
+                }
+            }
+            while (nearest < 0)
+            {
+                if (!visited[dist.sweep()[sweepPosition]])
+                    nearest = dist.sweep()[sweepPosition];
+                sweepPosition++;
+            }
+            tour.push_back(nearest);
+            visited[nearest] = true;
+            continue;
+        }
+        for (int next = 1; next <= n; next++)
+        {
+            if (!visited[next] && (nearest < 0 || dist(curr, next) < dist(curr, nearest)))
+                nearest = next;
+        }
+        tour.push_back(nearest);
+        visited[nearest] = true;
+    }
+    tour.push_back(0);
+    return tour;
+}
+
+  // 2-opt over each delivery's nearest neighbours: whenever replacing two legs (a,b) (c,d) with (a,c) (b,d) is
+  // shorter, reverse the stretch between them. Returns the improved tour's length.
+double DeliveryOptimizerImpl::improveWithTwoOpt(const CrowDistances& dist, vector<int>& tour) const
+{
+    const double EPSILON = 1e-12;
+    int n = dist.deliveryCount();
+    vector<int> position(n + 1);
+    for (int i = 1; i <= n; i++)
+        position[tour[i]] = i;
+    
+    bool improved = true;
+    for (int pass = 0; improved && pass < MAX_TWO_OPT_PASSES; pass++)
+    {
+        improved = false;
+        for (int i = 0; i <= n; i++)
+        {
+            int a = tour[i];
+            int b = tour[i + 1];
+            for (int c : dist.neighbours(a))
+            {
+                if (dist(a, c) >= dist(a, b))
+                    break;      // Neighbours are sorted, so no later c can help either
+                int j = position[c];
+                int d = tour[j + 1];
+                double gain = dist(a, b) + dist(c, d) - dist(a, c) - dist(b, d);
+                if (gain <= EPSILON)
+                    continue;
+                  // Reversing the stretch between the two legs reconnects them as (a,c) and (b,d)
+                int lo = (j > i) ? i + 1 : j + 1;
+                int hi = (j > i) ? j : i;
+                reverse(tour.begin() + lo, tour.begin() + hi + 1);
+                for (int k = lo; k <= hi; k++)
+                    position[tour[k]] = k;
+                improved = true;
+                break;
+            }
+        }
+    }
+    
+    double length = 0;
+    for (int i = 0; i <= n; i++)
+        length += dist(tour[i], tour[i + 1]);
+    return length;
+}
+
+  // Multi-start insertion (deliveries taken by closing time, by opening time, by window midpoint, in the untimed
+  // nearest-neighbour order, and most constrained first), each start improved with Or-opt; the best tour that meets
+  // every window wins
+bool DeliveryOptimizerImpl::optimizeDeliveryOrder(
+    const GeoCoord& depot,
+    vector<DeliveryRequest>& deliveries,
+    double milesPerHour,
+    double& newCrowDistance,
+    double& returnTime) const
+{
+    TRACE_SCOPE("DeliveryOptimizer::optimizeDeliveryOrder/timeWindows");
+    int n = (int) deliveries.size();
+    if (milesPerHour <= 0)
+        return false;
+    
+    Timing timing;
+    timing.milesPerHour = milesPerHour;
+    timing.open.push_back(0);
+    timing.close.push_back(numeric_limits<double>::infinity());
+    timing.service.push_back(0);
+    for (const DeliveryRequest& delivery : deliveries)
+    {
+        timing.open.push_back(delivery.windowOpen);
+        timing.close.push_back(delivery.windowClose);
+        timing.service.push_back(delivery.serviceTime);
+    }
+    CrowDistances dist(depot, deliveries);
+    
+    vector<int> original(1, 0);
+    for (int i = 1; i <= n; i++)
+        original.push_back(i);
+    original.push_back(0);
+    
+    const int STARTS = 5;
+    vector<vector<int>> tours(STARTS);
+    ThreadPool::shared().parallelFor(STARTS, [&](size_t k) {
+        vector<int> order(original.begin() + 1, original.end() - 1);
+        if (k == 4)
+            ;   // Most constrained first: the order does not matter
+        else if (k == 3)
+        {
+            if (n == 0)
+                return;
+            vector<int> nearest = nearestNeighbourTour(dist, 1);
+            order.assign(nearest.begin() + 1, nearest.end() - 1);
+        }
+        else
+        {
+              // Unbounded windows sort after every bounded one
+            auto key = [&](int i) {
+                double close = min(timing.close[i], numeric_limits<double>::max());
+                return k == 0 ? close : k == 1 ? timing.open[i] : (timing.open[i] + close) / 2;
+            };
+            stable_sort(order.begin(), order.end(), [&](int x, int y) { return key(x) < key(y); });
+        }
+        tours[k] = timedInsertionTour(dist, timing, order, k == 4);
+        if (!tours[k].empty())
+            improveWithOrOpt(dist, timing, tours[k]);
+    });
+    
+      // The given order competes too, so a feasible order is never replaced by a longer one
+    vector<double> earliest, latest;
+    const vector<int>* best = nullptr;
+    double bestLength = 0;
+    if (schedule(dist, timing, original, earliest, latest))
+    {
+        best = &original;
+        bestLength = tourLength(dist, original);
+    }
+    for (const vector<int>& tour : tours)
+    {
+        if (tour.empty())
+            continue;
+        double length = tourLength(dist, tour);
+        if (best == nullptr || length < bestLength)
+        {
+            best = &tour;
+            bestLength = length;
+        }
+    }
+    if (best == nullptr)
+        return false;
+    
+    schedule(dist, timing, *best, earliest, latest);
+    returnTime = earliest.back();
+    newCrowDistance = bestLength;
+    if (best != &original)
+    {
+        vector<DeliveryRequest> optimizedDeliveries;
+        optimizedDeliveries.reserve(n);
+        for (int i = 1; i <= n; i++)
+            optimizedDeliveries.push_back(deliveries[(*best)[i] - 1]);
+        deliveries = optimizedDeliveries;
+    }
+    return true;
+}
+
+bool DeliveryOptimizerImpl::schedule(const CrowDistances& dist, const Timing& timing, const vector<int>& tour, vector<double>& earliest, vector<double>& latest)
+{
+    size_t size = tour.size();
+    earliest.assign(size, 0);
+    latest.assign(size, numeric_limits<double>::infinity());
+    bool feasible = true;
+    for (size_t k = 1; k < size; k++)
+    {
+        int prev = tour[k - 1];
+        earliest[k] = max(timing.open[tour[k]], earliest[k - 1] + timing.service[prev] + timing.travel(dist, prev, tour[k]));
+        if (earliest[k] > timing.close[tour[k]])
+            feasible = false;
+    }
+    for (size_t k = size - 1; k-- > 0; )
+    {
+        int next = tour[k + 1];
+        latest[k] = min(timing.close[tour[k]], latest[k + 1] - timing.travel(dist, tour[k], next) - timing.service[tour[k]]);
+    }
+    return feasible;
+}
+
+  // Conservative when the run is being moved within the same tour: removing it only makes earlier service times
+  // possible and later deadlines looser, so the schedule of the tour with the run still in place over-estimates
+  // earliest[a] and under-estimates latest[a+1].
+bool DeliveryOptimizerImpl::fits(const CrowDistances& dist, const Timing& timing, const vector<int>& tour, const vector<double>& earliest,
+                                 const vector<double>& latest, int a, const int* run, int runLength)
+{
+    int prev = tour[a];
+    double start = earliest[a];
+    for (int i = 0; i < runLength; i++)
+    {
+        start = max(timing.open[run[i]], start + timing.service[prev] + timing.travel(dist, prev, run[i]));
+        if (start > timing.close[run[i]])
+            return false;
+        prev = run[i];
+    }
+    int next = tour[a + 1];
+    return max(timing.open[next], start + timing.service[prev] + timing.travel(dist, prev, next)) <= latest[a + 1];
+}
+
+void DeliveryOptimizerImpl::candidateGaps(const Timing& timing, const vector<double>& earliest, const vector<double>& latest, int location, int& first, int& last)
+{
+    first = (int) (lower_bound(latest.begin() + 1, latest.end(), timing.open[location]) - latest.begin()) - 1;
+    last = (int) (upper_bound(earliest.begin(), earliest.end() - 1, timing.close[location]) - earliest.begin()) - 1;
+}
+
+vector<int> DeliveryOptimizerImpl::timedInsertionTour(const CrowDistances& dist, const Timing& timing, const vector<int>& order, bool mostConstrainedFirst) const
+{
+    vector<int> tour = { 0, 0 };
+    tour.reserve(order.size() + 2);
+    vector<int> pending(order.rbegin(), order.rend());     // Taken from the back
+    vector<double> earliest, latest;
+    while (!pending.empty())
+    {
+        schedule(dist, timing, tour, earliest, latest);
+        
+          // The cheapest gap each candidate fits in, and how many gaps it fits in at all
+        size_t chosen = pending.size() - 1;
+        int chosenGap = -1, chosenFits = 0;
+        double chosenCost = 0;
+        size_t candidates = mostConstrainedFirst ? pending.size() : 1;
+        for (size_t c = pending.size() - candidates; c < pending.size(); c++)
+        {
+            int location = pending[c];
+            int first, last;
+            candidateGaps(timing, earliest, latest, location, first, last);
+            int bestGap = -1, fitCount = 0;
+            double bestCost = 0;
+            for (int a = max(first, 0); a <= last && a + 1 < (int) tour.size(); a++)
+            {
+                if (!fits(dist, timing, tour, earliest, latest, a, &location, 1))
+                    continue;
+                fitCount++;
+                double cost = dist(tour[a], location) + dist(location, tour[a + 1]) - dist(tour[a], tour[a + 1]);
+                if (bestGap < 0 || cost < bestCost)
+                {
+                    bestGap = a;
+                    bestCost = cost;
+                }
+            }
+            if (bestGap < 0)
+                return vector<int>();
+            if (chosenGap < 0 || fitCount < chosenFits || (fitCount == chosenFits && bestCost < chosenCost))
+            {
+                chosen = c;
+                chosenGap = bestGap;
+                chosenFits = fitCount;
+                chosenCost = bestCost;
+            }
+        }
+        tour.insert(tour.begin() + chosenGap + 1, pending[chosen]);
+        pending.erase(pending.begin() + chosen);
+    }
+    return tour;
+}
+
+void DeliveryOptimizerImpl::improveWithOrOpt(const CrowDistances& dist, const Timing& timing, vector<int>& tour) const
+{
+    const double EPSILON = 1e-12;
+    int n = (int) tour.size() - 2;
+    vector<double> earliest, latest;
+    schedule(dist, timing, tour, earliest, latest);
+    
+    bool improved = true;
+    for (int pass = 0; improved && pass < MAX_TWO_OPT_PASSES; pass++)
+    {
+        improved = false;
+        for (int p = 1; p <= n; p++)
+        {
+            for (int length = 1; length <= MAX_SEGMENT && p + length - 1 <= n; length++)
+            {
+                  // The run tour[p .. p+length-1], taken out from between before and after
+                int first = tour[p];
+                int last = tour[p + length - 1];
+                int before = tour[p - 1];
+                int after = tour[p + length];
+                double removal = dist(before, first) + dist(last, after) - dist(before, after);
+                int bestGap = -1;
+                double bestGain = EPSILON;
+                for (int a = 0; a <= n; a++)
+                {
+                    if (a >= p - 1 && a <= p + length - 1)
+                        continue;       // Gaps next to or inside the run
+                    double gain = removal - (dist(tour[a], first) + dist(last, tour[a + 1]) - dist(tour[a], tour[a + 1]));
+                    if (gain > bestGain && fits(dist, timing, tour, earliest, latest, a, &tour[p], length))
+                    {
+                        bestGap = a;
+                        bestGain = gain;
+                    }
+                }
+                if (bestGap < 0)
+                    continue;
+                
+                vector<int> run(tour.begin() + p, tour.begin() + p + length);
+                tour.erase(tour.begin() + p, tour.begin() + p + length);
+                int insertAt = (bestGap < p) ? bestGap + 1 : bestGap + 1 - length;
+                tour.insert(tour.begin() + insertAt, run.begin(), run.end());
+                schedule(dist, timing, tour, earliest, latest);
+                improved = true;
+                break;
+            }
+        }
+    }
+}
+
+double DeliveryOptimizerImpl::tourLength(const CrowDistances& dist, const vector<int>& tour)
+{
+    double length = 0;
+    for (size_t i = 0; i + 1 < tour.size(); i++)
+        length += dist(tour[i], tour[i + 1]);
+    return length;
+}
+
+  // Multi-robot mode: savings construction, fitted to the robots' capacities, then alternating rounds of moves
+  // between routes and 2-opt within them. Returns false (leaving plan alone) if the robots cannot carry every delivery.
+bool DeliveryOptimizerImpl::optimizeFleet(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    const vector<int>& capacities,
+    FleetPlan& plan,
+    double balanceWeight) const
+{
+    TRACE_SCOPE("DeliveryOptimizer::optimizeFleet");
+    int robots = (int) capacities.size();
+    int n = (int) deliveries.size();
+    long long totalCapacity = 0;
+    int maxCapacity = 0;
+    for (int capacity : capacities)
+    {
+        if (capacity < 0)
+            return false;
+        totalCapacity += capacity;
+        maxCapacity = max(maxCapacity, capacity);
+    }
+    if (robots == 0 || totalCapacity < n || balanceWeight < 0)
+        return false;
+    
+    FleetPlan result;
+    result.tours.resize(robots);
+    result.crowDistances.assign(robots, 0);
+    if (n > 0)
+    {
+        CrowDistances dist(depot, deliveries);
+        FleetRoutes fleet = assignRobots(dist, savingsRoutes(dist, maxCapacity), capacities);
+        improveEachRoute(depot, deliveries, dist, fleet);
+        for (int round = 0; round < MAX_FLEET_ROUNDS; round++)
+        {
+            if (!improveBetweenRoutes(dist, fleet, balanceWeight))
+                break;
+            improveEachRoute(depot, deliveries, dist, fleet);
+        }
+        
+        for (int k = 0; k < robots; k++)
+        {
+            for (int location : fleet.stops[k])
+                result.tours[k].push_back(deliveries[location - 1]);
+            result.crowDistances[k] = fleet.length[k];
+            result.totalCrowDistance += fleet.length[k];
+            result.longestCrowDistance = max(result.longestCrowDistance, fleet.length[k]);
+        }
+    }
+    plan = move(result);
+    return true;
+}
+
+vector<vector<int>> DeliveryOptimizerImpl::savingsRoutes(const CrowDistances& dist, int capacity) const
+{
+    TRACE_SCOPE("DeliveryOptimizer::savingsRoutes");
+    int n = dist.deliveryCount();
+    vector<vector<int>> routes(n + 1);      // Route r starts as just delivery r; routes[0] is unused
+    vector<int> routeOf(n + 1);
+    for (int i = 1; i <= n; i++)
+    {
+        routes[i].push_back(i);
+        routeOf[i] = i;
+    }
+    
+    struct Saving
+    {
+        double value;
+        int i, j;
+    };
+    vector<Saving> savings;
+    if (dist.onDemand())
+    {
+          // Only pairs of neighbours: O(n) savings rather than O(n^2). Joining far-apart deliveries saves little.
+        for (int i = 1; i <= n; i++)
+        {
+            for (int j : dist.neighbours(i))
+            {
+                double value = dist(0, i) + dist(0, j) - dist(i, j);
+                if (value > 0)
+                    savings.push_back(Saving{value, min(i, j), max(i, j)});
+            }
+        }
+    }
+    else
+    {
+        savings.reserve((size_t) n * (n - 1) / 2);
+        for (int i = 1; i <= n; i++)
+        {
+            for (int j = i + 1; j <= n; j++)
+            {
+                double value = dist(0, i) + dist(0, j) - dist(i, j);
+                if (value > 0)
+                    savings.push_back(Saving{value, i, j});
+            }
+        }
+    }
+    sort(savings.begin(), savings.end(), [](const Saving& x, const Saving& y) {
+        if (x.value != y.value)
+            return x.value > y.value;
+        return x.i != y.i ? x.i < y.i : x.j < y.j;
+    });
+      // Neighbours of each other appear twice
+    savings.erase(unique(savings.begin(), savings.end(), [](const Saving& x, const Saving& y) {
+        return x.i == y.i && x.j == y.j;
+    }), savings.end());
+    
+    for (const Saving& saving : savings)
+    {
+        int a = routeOf[saving.i];
+        int b = routeOf[saving.j];
+        if (a == b || routes[a].size() + routes[b].size() > (size_t) capacity)
+            continue;
+        vector<int>& first = routes[a];
+        vector<int>& second = routes[b];
+          // Both deliveries must be at an end of their routes (next to the depot) to be joined
+        if ((first.front() != saving.i && first.back() != saving.i) || (second.front() != saving.j && second.back() != saving.j))
+            continue;
+          // Turn the routes so that the joined route runs ... -> i -> j -> ...
+        if (first.back() != saving.i)
+            reverse(first.begin(), first.end());
+        if (second.front() != saving.j)
+            reverse(second.begin(), second.end());
+        first.insert(first.end(), second.begin(), second.end());
+        for (int location : second)
+            routeOf[location] = a;
+        vector<int>().swap(second);
+    }
+    
+    vector<vector<int>> result;
+    for (vector<int>& route : routes)
+    {
+        if (!route.empty())
+            result.push_back(move(route));
+    }
+    return result;
+}
+
+DeliveryOptimizerImpl::FleetRoutes DeliveryOptimizerImpl::assignRobots(const CrowDistances& dist, vector<vector<int>> routes, const vector<int>& capacities) const
+{
+    int robots = (int) capacities.size();
+    int maxCapacity = *max_element(capacities.begin(), capacities.end());
+    
+      // More routes than robots: break up the smallest and spread its deliveries over the others. (There is always
+      // room: robots * maxCapacity >= total capacity >= deliveries.)
+    while ((int) routes.size() > robots)
+    {
+        auto smallest = min_element(routes.begin(), routes.end(), [](const vector<int>& x, const vector<int>& y) {
+            return x.size() < y.size();
+        });
+        vector<int> orphaned = move(*smallest);
+        routes.erase(smallest);
+        vector<int> room(routes.size(), maxCapacity);
+        for (int location : orphaned)
+            insertCheapest(dist, routes, room, location);
+    }
+    
+      // The biggest routes go to the biggest robots; robots left over start out with nothing to deliver
+    sort(routes.begin(), routes.end(), [](const vector<int>& x, const vector<int>& y) { return x.size() > y.size(); });
+    routes.resize(robots);
+    vector<int> byCapacity(robots);
+    for (int k = 0; k < robots; k++)
+        byCapacity[k] = k;
+    stable_sort(byCapacity.begin(), byCapacity.end(), [&](int x, int y) { return capacities[x] > capacities[y]; });
+    
+    FleetRoutes fleet;
+    fleet.stops.resize(robots);
+    fleet.capacity = capacities;
+    fleet.length.assign(robots, 0);
+    fleet.routeOf.assign(dist.deliveryCount() + 1, -1);
+    fleet.positionOf.assign(dist.deliveryCount() + 1, -1);
+    for (int r = 0; r < robots; r++)
+        fleet.stops[byCapacity[r]] = move(routes[r]);
+    
+      // A route that is still too big for its robot sheds the deliveries that cost it the most, into routes with room
+    for (int k = 0; k < robots; k++)
+    {
+        vector<int>& stops = fleet.stops[k];
+        while ((int) stops.size() > fleet.capacity[k])
+        {
+            size_t worst = 0;
+            double worstSaving = -1;
+            for (size_t i = 0; i < stops.size(); i++)
+            {
+                int p = (i == 0) ? 0 : stops[i - 1];
+                int q = (i + 1 == stops.size()) ? 0 : stops[i + 1];
+                double saving = dist(p, stops[i]) + dist(stops[i], q) - dist(p, q);
+                if (saving > worstSaving)
+                {
+                    worst = i;
+                    worstSaving = saving;
+                }
+            }
+            int location = stops[worst];
+            stops.erase(stops.begin() + worst);
+            insertCheapest(dist, fleet.stops, fleet.capacity, location);
+        }
+    }
+    for (int k = 0; k < robots; k++)
+        refresh(dist, fleet, k);
+    return fleet;
+}
+
+bool DeliveryOptimizerImpl::improveBetweenRoutes(const CrowDistances& dist, FleetRoutes& fleet, double balanceWeight) const
+{
+    const double EPSILON = 1e-12;
+    int n = dist.deliveryCount();
+    int robots = (int) fleet.stops.size();
+    auto before = [&](int route, int position) { return position == 0 ? 0 : fleet.stops[route][position - 1]; };
+    auto after = [&](int route, int position) {
+        return position + 1 >= (int) fleet.stops[route].size() ? 0 : fleet.stops[route][position + 1];
+    };
+      // The longest tour if routes a and b had these lengths
+    auto longestWith = [&](int a, double lengthA, int b, double lengthB) {
+        double longest = max(lengthA, lengthB);
+        for (int k = 0; k < robots; k++)
+        {
+            if (k != a && k != b)
+                longest = max(longest, fleet.length[k]);
+        }
+        return longest;
+    };
+    
+    bool movedAny = false;
+    bool moved = true;
+    for (int pass = 0; moved && pass < MAX_TWO_OPT_PASSES; pass++)
+    {
+        moved = false;
+        for (int u = 1; u <= n; u++)
+        {
+            int a = fleet.routeOf[u];
+            int i = fleet.positionOf[u];
+            int p = before(a, i);
+            int q = after(a, i);
+            double longest = *max_element(fleet.length.begin(), fleet.length.end());
+            double removal = dist(p, u) + dist(u, q) - dist(p, q);
+            
+              // The best move for u: relocating it next to a neighbour (or into an empty route), or swapping the two
+            double bestDelta = -EPSILON;
+            int bestRoute = -1, bestPosition = -1, swapWith = 0;
+            auto consider = [&](int b, double lengthA, double lengthB, int position, int other) {
+                double delta = lengthA + lengthB - fleet.length[a] - fleet.length[b] +
+                               balanceWeight * (longestWith(a, lengthA, b, lengthB) - longest);
+                if (delta < bestDelta)
+                {
+                    bestDelta = delta;
+                    bestRoute = b;
+                    bestPosition = position;
+                    swapWith = other;
+                }
+            };
+            for (int v : dist.neighbours(u))
+            {
+                int b = fleet.routeOf[v];
+                if (b == a)
+                    continue;
+                int j = fleet.positionOf[v];
+                int pv = before(b, j);
+                int qv = after(b, j);
+                if ((int) fleet.stops[b].size() < fleet.capacity[b])
+                {
+                    consider(b, fleet.length[a] - removal, fleet.length[b] + dist(pv, u) + dist(u, v) - dist(pv, v), j, 0);
+                    consider(b, fleet.length[a] - removal, fleet.length[b] + dist(v, u) + dist(u, qv) - dist(v, qv), j + 1, 0);
+                }
+                consider(b, fleet.length[a] + dist(p, v) + dist(v, q) - dist(p, u) - dist(u, q),
+                         fleet.length[b] + dist(pv, u) + dist(u, qv) - dist(pv, v) - dist(v, qv), j, v);
+            }
+            for (int b = 0; b < robots; b++)
+            {
+                if (b != a && fleet.stops[b].empty() && fleet.capacity[b] > 0)
+                    consider(b, fleet.length[a] - removal, 2 * dist(0, u), 0, 0);
+            }
+            if (bestRoute < 0)
+                continue;
+            
+            if (swapWith != 0)
+            {
+                fleet.stops[a][i] = swapWith;
+                fleet.stops[bestRoute][bestPosition] = u;
+            }
+            else
+            {
+                fleet.stops[a].erase(fleet.stops[a].begin() + i);
+                fleet.stops[bestRoute].insert(fleet.stops[bestRoute].begin() + bestPosition, u);
+            }
+            refresh(dist, fleet, a);
+            refresh(dist, fleet, bestRoute);
+            moved = movedAny = true;
+        }
+    }
+    return movedAny;
+}
+
+void DeliveryOptimizerImpl::improveEachRoute(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries, const CrowDistances& dist, FleetRoutes& fleet) const
+{
+      // Routes share no locations, so each job only touches its own route's entries
+    ThreadPool::shared().parallelFor(fleet.stops.size(), [&](size_t k) {
+        vector<int>& stops = fleet.stops[k];
+        if (stops.size() < 3)
+            return;
+        vector<DeliveryRequest> routeDeliveries;
+        for (int location : stops)
+            routeDeliveries.push_back(deliveries[location - 1]);
+        CrowDistances routeDist(depot, routeDeliveries);
+        vector<int> tour(1, 0);
+        for (size_t i = 1; i <= stops.size(); i++)
+            tour.push_back((int) i);
+        tour.push_back(0);
+        improveWithTwoOpt(routeDist, tour);
+        vector<int> improved;
+        for (size_t i = 1; i <= stops.size(); i++)
+            improved.push_back(stops[tour[i] - 1]);
+        stops = improved;
+        refresh(dist, fleet, (int) k);
+    });
+}
+
+void DeliveryOptimizerImpl::insertCheapest(const CrowDistances& dist, vector<vector<int>>& routes, const vector<int>& capacity, int location)
+{
+    int bestRoute = -1;
+    size_t bestPosition = 0;
+    double bestCost = 0;
+    for (size_t r = 0; r < routes.size(); r++)
+    {
+        if ((int) routes[r].size() >= capacity[r])
+            continue;
+        for (size_t position = 0; position <= routes[r].size(); position++)
+        {
+            int p = (position == 0) ? 0 : routes[r][position - 1];
+            int q = (position == routes[r].size()) ? 0 : routes[r][position];
+            double cost = dist(p, location) + dist(location, q) - dist(p, q);
+            if (bestRoute < 0 || cost < bestCost)
+            {
+                bestRoute = (int) r;
+                bestPosition = position;
+                bestCost = cost;
+            }
+        }
+    }
+    routes[bestRoute].insert(routes[bestRoute].begin() + bestPosition, location);
+}
+
+void DeliveryOptimizerImpl::refresh(const CrowDistances& dist, FleetRoutes& fleet, int route)
+{
+    const vector<int>& stops = fleet.stops[route];
+    double length = 0;
+    int prev = 0;
+    for (size_t i = 0; i < stops.size(); i++)
+    {
+        fleet.routeOf[stops[i]] = route;
+        fleet.positionOf[stops[i]] = (int) i;
+        length += dist(prev, stops[i]);
+        prev = stops[i];
+    }
+    fleet.length[route] = length + dist(prev, 0);
+}
+
 //******************** DeliveryOptimizer functions ****************************
 
 // These functions simply delegate to DeliveryOptimizerImpl's functions.
@@ -128,3 +1051,23 @@ void DeliveryOptimizer::optimizeDeliveryOrder(
 {
     return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance);
 }
+
+bool DeliveryOptimizer::optimizeFleet(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        const vector<int>& capacities,
+        FleetPlan& plan,
+        double balanceWeight) const
+{
+    return m_impl->optimizeFleet(depot, deliveries, capacities, plan, balanceWeight);
+}
+
+bool DeliveryOptimizer::optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double milesPerHour,
+        double& newCrowDistance,
+        double& returnTime) const
+{
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, milesPerHour, newCrowDistance, returnTime);
+}
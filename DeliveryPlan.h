@@ -0,0 +1,25 @@
+// DeliveryPlan.h
+// A delivery plan that remembers how it was built: the visiting order, every routed leg and where each leg's
+// commands are. DeliveryPlanner::insertDelivery uses this to absorb a late order by routing only the legs it
+// changes and patching the commands in place, instead of planning again from scratch.
+
+#ifndef DELIVERYPLAN_INCLUDED
+#define DELIVERYPLAN_INCLUDED
+
+#include "provided.h"
+#include <cstddef>
+#include <list>
+#include <vector>
+
+struct DeliveryPlan
+{
+    GeoCoord depot;
+    std::vector<DeliveryRequest> stops;             // In visiting order
+    std::vector<std::list<StreetSegment>> legs;     // legs[i] ends at stops[i]; the last leg returns to the depot
+    std::vector<double> legMiles;
+    std::vector<std::size_t> legCommands;           // Leg i's commands (ending with its Deliver) start at commands[legCommands[i]]
+    std::vector<DeliveryCommand> commands;
+    double totalDistanceTravelled = 0;
+};
+
+#endif // DELIVERYPLAN_INCLUDED
@@ -1,4 +1,17 @@
 #include "provided.h"
+#include "AsyncPlanning.h"
+#include "DeliveryPlan.h"
+#include "StreetMapSnapshot.h"
+#include "Trace.h"
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -12,13 +25,136 @@ class DeliveryPlannerImpl
         const vector<DeliveryRequest>& deliveries,
         vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        const function<void(const DeliveryCommand&)>& onCommand,
+        double& totalDistanceTravelled) const;
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        DeliveryPlan& plan) const;
+    DeliveryResult insertDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery, size_t earliestStop) const;
+    Task<PlanResult> generateDeliveryPlanAsync(GeoCoord depot, vector<DeliveryRequest> deliveries) const;
+    void setRouteCache(shared_ptr<const RouteCache> cache);
   private:
     const StreetMap* m_streetMap;        // Pointer to a fully-constructed and loaded StreetMap object
+    shared_ptr<const RouteCache> m_routeCache;     // Passed on to each leg's router. Swapped with atomic_store
+    
+    static constexpr size_t INSERTION_CANDIDATES = 4;  // Positions routed for a late delivery, chosen by crow detour
     
+      // The streamed plan; if record is not nullptr, the stops, legs and commands are also kept there
+    DeliveryResult planLegs(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        const function<void(const DeliveryCommand&)>& onCommand,
+        double& totalDistanceTravelled,
+        DeliveryPlan* record) const;
+    
+      // Converts one leg's StreetSegments into Proceed and Turn commands, appending them to commands
+    void generateLegCommands(const list<StreetSegment>& route, vector<DeliveryCommand>& commands) const;
     string angleToProceedDir(double angle) const;       // Returns the direction based on the input angle for a Proceed cmd
     string angleToTurnDir(double angle) const;          // Return the direction based on the input angle for a Turn cmd
 };
 
+namespace
+{
+      // One routed movement of the robot: depot -> first delivery, delivery -> delivery, or last delivery -> depot
+    struct Leg
+    {
+        DeliveryResult result;
+        list<StreetSegment> route;
+        double distance = 0;
+    };
+
+      // One plan's legs: the jobs that route them, and the routed legs, collected in order for the thread generating
+      // commands. The jobs wait in the plan's own queue. The pool gets one job per leg that runs whichever leg is
+      // next in the queue, and the thread generating commands runs them too while it waits. It never runs anything
+      // else from the pool, so another plan can't start on its stack and hold up this plan's commands.
+    class LegSlots
+    {
+      public:
+        explicit LegSlots(size_t count) : m_legs(count), m_ready(count, false), m_running(0) {}
+
+        void add(function<void()> job)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_jobs.push_back(move(job));
+        }
+          // Runs the next queued leg job; returns false if there was none
+        bool runJob()
+        {
+            function<void()> job;
+            {
+                lock_guard<mutex> lock(m_mutex);
+                if (m_jobs.empty())
+                    return false;
+                job = move(m_jobs.front());
+                m_jobs.pop_front();
+                m_running++;
+            }
+            job();
+            lock_guard<mutex> lock(m_mutex);
+            m_running--;
+            m_changed.notify_all();
+            return true;
+        }
+        void fill(size_t i, Leg&& leg)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_legs[i] = move(leg);
+            m_ready[i] = true;
+            m_changed.notify_all();
+        }
+
+          // Waits for leg i, routing queued legs (such as i itself) in the meantime
+        Leg take(size_t i)
+        {
+            waitFor([this, i] { return m_ready[i]; });
+            lock_guard<mutex> lock(m_mutex);
+            return move(m_legs[i]);
+        }
+          // Drops the legs nobody has started on and waits for the rest. The pool's jobs for dropped legs find the
+          // queue empty; they hold a shared_ptr to the LegSlots, so it outlives them.
+        void cancel()
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_jobs.clear();
+            }
+            waitFor([this] { return m_running == 0; });
+        }
+
+      private:
+          // Once this plan's queue is empty, every leg waited for is being routed on some thread, so sleeping until
+          // it finishes is safe
+        template<typename Predicate>
+        void waitFor(Predicate done)
+        {
+            for (;;)
+            {
+                {
+                    lock_guard<mutex> lock(m_mutex);
+                    if (done())
+                        return;
+                }
+                if (!runJob())
+                {
+                    unique_lock<mutex> lock(m_mutex);
+                    m_changed.wait(lock, [&] { return done() || !m_jobs.empty(); });
+                }
+            }
+        }
+
+        mutex m_mutex;
+        condition_variable m_changed;
+        deque<function<void()>> m_jobs;
+        vector<Leg> m_legs;
+        vector<bool> m_ready;
+        int m_running;
+    };
+}
+
 DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm)
 {
     m_streetMap = sm;           // Pointer to a fully-constructed and loaded StreetMap object
@@ -34,126 +170,298 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
     vector<DeliveryCommand>& commands,
     double& totalDistanceTravelled) const
 {
+      // Buffer the streamed plan, and only hand it over if every leg could be routed
+    vector<DeliveryCommand> planned;
+    DeliveryResult result = generateDeliveryPlan(depot, deliveries, [&planned](const DeliveryCommand& cmd) {
+        planned.push_back(cmd);
+    }, totalDistanceTravelled);
+    if (result == DELIVERY_SUCCESS)
+        commands.insert(commands.end(), planned.begin(), planned.end());
+    return result;
+}
+
+DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    const function<void(const DeliveryCommand&)>& onCommand,
+    double& totalDistanceTravelled) const
+{
+    return planLegs(depot, deliveries, onCommand, totalDistanceTravelled, nullptr);
+}
+
+DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryPlan& plan) const
+{
+    DeliveryPlan planned;
+    double totalDistanceTravelled;
+    DeliveryResult result = planLegs(depot, deliveries, [](const DeliveryCommand&) {}, totalDistanceTravelled, &planned);
+    if (result == DELIVERY_SUCCESS)
+    {
+        planned.totalDistanceTravelled = totalDistanceTravelled;
+        plan = move(planned);
+    }
+    return result;
+}
+
+DeliveryResult DeliveryPlannerImpl::planLegs(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    const function<void(const DeliveryCommand&)>& onCommand,
+    double& totalDistanceTravelled,
+    DeliveryPlan* record) const
+{
+    TRACE_SCOPE("DeliveryPlanner::generateDeliveryPlan");
+    totalDistanceTravelled = 0;         // Reset the total Distance Travelled to 0
+    
+      // Reject bad coordinates, and deliveries in a part of the map the depot is not connected to, before a single
+      // command goes out (or any time is spent ordering them). A plan can still fail part way through if closures
+      // have cut a delivery off; commands already passed to onCommand then stand. (On a tiled map, only the tiles
+      // the stops lie in are needed to check coordinates; connectivity is left to the routers unless all are loaded.)
+    vector<GeoCoord> stops{ depot };
+    for (const DeliveryRequest& delivery : deliveries)
+        stops.push_back(delivery.location);
+    shared_ptr<const StreetMapSnapshot> map = m_streetMap->snapshotCovering(stops, 0);
+    auto onMap = [&map](const GeoCoord& gc) {
+        int node = map->nodeId(gc);
+        return node >= 0 && !map->edges(node).empty();
+    };
+    if (!onMap(depot))
+        return BAD_COORD;
+    for (const DeliveryRequest& delivery : deliveries)
+        if (!onMap(delivery.location))
+            return BAD_COORD;
+    int depotComponent = map->component(map->nodeId(depot));
+    for (const DeliveryRequest& delivery : deliveries)
+        if (map->complete() && map->component(map->nodeId(delivery.location)) != depotComponent)
+            return NO_ROUTE;
+    
       // First, reorder the order of delivery requests to optimize/reduce the total travel distance
     DeliveryOptimizer optimizer(m_streetMap);
     double oldCrowDistance, newCrowDistance;
-      // Cast the deliveries vector to a non-const vector optimizedDeliveries
-    vector<DeliveryRequest> optimizedDeliveries = const_cast <const vector<DeliveryRequest>&> (deliveries);
+    vector<DeliveryRequest> optimizedDeliveries = deliveries;
     optimizer.optimizeDeliveryOrder(depot, optimizedDeliveries, oldCrowDistance, newCrowDistance);
     
-    totalDistanceTravelled = 0;         // Reset the total Distance Travelled to 0
+    if (record != nullptr)
+    {
+        record->depot = depot;
+        record->stops = optimizedDeliveries;
+    }
     
+      // Then, generate point-to-point routes between the depot to each successive optimized delivery point, then back
+      // to the depot (using the PointToPointRouter class). The legs are independent, so each is routed by its own
+      // job on the shared pool; the commands for the first legs go out while later ones are still being routed.
+    ThreadPool& pool = ThreadPool::shared();
+    shared_ptr<const RouteCache> routeCache = atomic_load(&m_routeCache);
+    size_t legCount = optimizedDeliveries.size() + 1;
+    shared_ptr<LegSlots> legs = make_shared<LegSlots>(legCount);
     
-      // Then, generate point-to-point routes between the depot to each successive optimized delivery point, then back to the depot (using the PointToPointRouter class)
-    PointToPointRouter router(m_streetMap);
-    GeoCoord prev = depot;
-    vector<list<StreetSegment>> totalRoute;     // Vector to hold the route for each movement
-    list<StreetSegment> route;                  // List to hold the route for each movement
-    double currTravelDistance;                  // Travel distance for each movement, will be added to total dist
+      // However the consumer below exits, the remaining legs are cancelled and the ones in progress waited for
+    struct CancelLegs
+    {
+        LegSlots& legs;
+        ~CancelLegs() { legs.cancel(); }
+    } cancelLegs{*legs};
     
-      // For every movement to a new location, generate a list of StreetSegments to follow. Push onto a larger list
-    vector<DeliveryRequest>::iterator delivery = optimizedDeliveries.begin();
-    while (delivery != optimizedDeliveries.end())
+    for (size_t i = 0; i < legCount; i++)
     {
-        DeliveryResult result = router.generatePointToPointRoute(prev, delivery->location, route, currTravelDistance);       // Generate route
+        const GeoCoord& from = (i == 0) ? depot : optimizedDeliveries[i - 1].location;
+        const GeoCoord& to = (i < optimizedDeliveries.size()) ? optimizedDeliveries[i].location : depot;
+        legs->add([this, &legs = *legs, &from, &to, &routeCache, i]() {
+            TRACE_SCOPE("DeliveryPlanner::routeLeg");
+            PointToPointRouter router(m_streetMap);
+            router.setRouteCache(routeCache);
+            Leg leg;
+            leg.result = router.generatePointToPointRoute(from, to, leg.route, leg.distance);       // Generate route
+            legs.fill(i, move(leg));
+        });
+        pool.submit([legs]() { legs->runJob(); });
+    }
+    
+      /* For each sequence of point-to-point StreetSegments generated by PointToPointRouter in the previous step, generate a sequence of DeliveryCommands representing instructions to the delivery robot. This involves:
+      o Converting the sequence of StreetSegments produced by the PointToPointRouter class (e.g., from the depot to the first delivery coordinate, or from the Nth to the N+1st delivery coordinate, or from the last delivery coordinate back to the depot) into one or more proceed or turn DeliveryCommands.
+      o After generating the proceed and turn DeliveryCommands to get to the robot to the next delivery location, generate a deliver DeliveryCommand indicating that a food item should be delivered at that location. */
+    vector<DeliveryCommand> legCommands;
+    for (size_t i = 0; i < legCount; i++)
+    {
+        Leg leg = legs->take(i);
         
           // Check to make sure the point to point route was generated successfully
-        if (result == NO_ROUTE || result == BAD_COORD)
-            return result;
-        
-        totalDistanceTravelled += currTravelDistance;
+        if (leg.result != DELIVERY_SUCCESS)
+            return leg.result;
+        totalDistanceTravelled += leg.distance;
         
-          // Add the route for this movement to the vector for all routes
-        totalRoute.push_back(route);
+        TRACE_SCOPE("DeliveryPlanner::generateCommands");
+        legCommands.clear();
+        generateLegCommands(leg.route, legCommands);
         
-        //totalDistanceTravelled += currTravelDistance;       // Update the totalDistanceTravelled
-        prev = delivery->location;                          // Update prev
-        delivery++;                           // Increment iterator to next DeliveryRequest
+            // Check to see that the robot is delivering something and not returning to the depot...
+        if (i < optimizedDeliveries.size())
+        {
+                // Generate a deliver DeliveryCommand indicating that a food item should be delivered at that location
+            DeliveryCommand deliver;
+            deliver.initAsDeliverCommand(optimizedDeliveries[i].item);
+            legCommands.push_back(deliver);
+        }
+        for (const DeliveryCommand& cmd : legCommands)
+            onCommand(cmd);
+        if (record != nullptr)
+        {
+            record->legCommands.push_back(record->commands.size());
+            record->commands.insert(record->commands.end(), legCommands.begin(), legCommands.end());
+            record->legs.push_back(move(leg.route));
+            record->legMiles.push_back(leg.distance);
+        }
     }
     
-      // prev should be the GeoCoord of the last DeliveryRequest now. We need to go back to the depot.
-    DeliveryResult result = router.generatePointToPointRoute(prev, depot, route, currTravelDistance);       // Generate route
+    return DELIVERY_SUCCESS;        // If we got here, we successfully delivered
+}
+
+  // Leg p of the plan (from stop p-1, or the depot, to stop p, or back to the depot) is replaced by two: to the new
+  // delivery and on from it. Positions are shortlisted by crow detour, then the candidates' legs are routed in
+  // parallel and the one adding the fewest road miles wins.
+DeliveryResult DeliveryPlannerImpl::insertDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery, size_t earliestStop) const
+{
+    TRACE_SCOPE("DeliveryPlanner::insertDelivery");
+    size_t stopCount = plan.stops.size();
+    if (earliestStop > stopCount || plan.legs.size() != stopCount + 1)
+        return NO_ROUTE;        // Nowhere left to put it (or not a plan from generateDeliveryPlan)
+    shared_ptr<const StreetMapSnapshot> map = m_streetMap->snapshotCovering(vector<GeoCoord>{ delivery.location, plan.depot }, 0);
+    int node = map->nodeId(delivery.location);
+    if (node < 0 || map->edges(node).empty())
+        return BAD_COORD;
+    if (map->complete() && !map->sameComponent(node, map->nodeId(plan.depot)))
+        return NO_ROUTE;        // Cut off from the depot, so from every stop on the plan too
+    
+    auto legStart = [&](size_t p) -> const GeoCoord& { return p == 0 ? plan.depot : plan.stops[p - 1].location; };
+    auto legEnd = [&](size_t p) -> const GeoCoord& { return p < stopCount ? plan.stops[p].location : plan.depot; };
+    vector<pair<double, size_t>> ranked;   // (crow detour, position)
+    for (size_t p = earliestStop; p <= stopCount; p++)
+    {
+        double detour = distanceEarthMiles(legStart(p), delivery.location) + distanceEarthMiles(delivery.location, legEnd(p)) -
+                        distanceEarthMiles(legStart(p), legEnd(p));
+        ranked.push_back(make_pair(detour, p));
+    }
+    size_t candidates = min(ranked.size(), INSERTION_CANDIDATES);
+    partial_sort(ranked.begin(), ranked.begin() + candidates, ranked.end());
     
-      // Check to make sure the point to point route was generated successfully
-    if (result == NO_ROUTE || result == BAD_COORD)
-        return result;
+      // Each candidate's two legs, as pool jobs: routed[2k] to the new delivery, routed[2k + 1] on from it
+    shared_ptr<const RouteCache> routeCache = atomic_load(&m_routeCache);
+    vector<Leg> routed(2 * candidates);
+    ThreadPool::shared().parallelFor(routed.size(), [&](size_t j) {
+        TRACE_SCOPE("DeliveryPlanner::routeLeg");
+        size_t p = ranked[j / 2].second;
+        PointToPointRouter router(m_streetMap);
+        router.setRouteCache(routeCache);
+        Leg& leg = routed[j];
+        if (j % 2 == 0)
+            leg.result = router.generatePointToPointRoute(legStart(p), delivery.location, leg.route, leg.distance);
+        else
+            leg.result = router.generatePointToPointRoute(delivery.location, legEnd(p), leg.route, leg.distance);
+    });
+    int best = -1;
+    double bestAdded = 0;
+    for (size_t k = 0; k < candidates; k++)
+    {
+        if (routed[2 * k].result != DELIVERY_SUCCESS || routed[2 * k + 1].result != DELIVERY_SUCCESS)
+            continue;
+        double added = routed[2 * k].distance + routed[2 * k + 1].distance - plan.legMiles[ranked[k].second];
+        if (best < 0 || added < bestAdded)
+        {
+            best = (int) k;
+            bestAdded = added;
+        }
+    }
+    if (best < 0)
+        return NO_ROUTE;
     
-    totalRoute.push_back(route);                        // Add the route for this movement to the vector for all routes
-    totalDistanceTravelled += currTravelDistance;       // Update the totalDistanceTravelled, for the final time
+      // The leg to the new delivery ends by delivering it; the leg on from it takes over the replaced leg's Deliver
+    size_t p = ranked[best].second;
+    Leg& toDelivery = routed[2 * best];
+    Leg& fromDelivery = routed[2 * best + 1];
+    vector<DeliveryCommand> replacement;
+    generateLegCommands(toDelivery.route, replacement);
+    DeliveryCommand deliver;
+    deliver.initAsDeliverCommand(delivery.item);
+    replacement.push_back(deliver);
+    size_t secondLegStart = replacement.size();
+    generateLegCommands(fromDelivery.route, replacement);
+    if (p < stopCount)
+    {
+        deliver.initAsDeliverCommand(plan.stops[p].item);
+        replacement.push_back(deliver);
+    }
     
-      /* For each sequence of point-to-point StreetSegments generated by PointToPointRouter in the previous step, generate a sequence of DeliveryCommands representing instructions to the delivery robot. This involves:
-      o Converting the sequence of StreetSegments produced by the PointToPointRouter class (e.g., from the depot to the first delivery coordinate, or from the Nth to the N+1st delivery coordinate, or from the last delivery coordinate back to the depot) into one or more proceed or turn DeliveryCommands.
-      o After generating the proceed and turn DeliveryCommands to get to the robot to the next delivery location, generate a deliver DeliveryCommand indicating that a food item should be delivered at that location. */
+    size_t begin = plan.legCommands[p];
+    size_t end = (p + 1 < plan.legCommands.size()) ? plan.legCommands[p + 1] : plan.commands.size();
+    plan.commands.erase(plan.commands.begin() + begin, plan.commands.begin() + end);
+    plan.commands.insert(plan.commands.begin() + begin, replacement.begin(), replacement.end());
+    for (size_t i = p + 1; i < plan.legCommands.size(); i++)
+        plan.legCommands[i] = plan.legCommands[i] + replacement.size() - (end - begin);
+    plan.legCommands.insert(plan.legCommands.begin() + p + 1, begin + secondLegStart);
     
-    delivery = optimizedDeliveries.begin();     // Keeps track of which delivery
-          // For each sequence of point-to-point StreetSegments...
-    for (int i = 0; i < totalRoute.size(); i++)
+    plan.legs[p] = move(toDelivery.route);
+    plan.legs.insert(plan.legs.begin() + p + 1, move(fromDelivery.route));
+    plan.legMiles[p] = toDelivery.distance;
+    plan.legMiles.insert(plan.legMiles.begin() + p + 1, fromDelivery.distance);
+    plan.stops.insert(plan.stops.begin() + p, delivery);
+    plan.totalDistanceTravelled += bestAdded;
+    return DELIVERY_SUCCESS;
+}
+
+void DeliveryPlannerImpl::setRouteCache(shared_ptr<const RouteCache> cache)
+{
+    atomic_store(&m_routeCache, cache);
+}
+
+Task<PlanResult> DeliveryPlannerImpl::generateDeliveryPlanAsync(GeoCoord depot, vector<DeliveryRequest> deliveries) const
+{
+    co_await resumeOn(ThreadPool::shared());
+    PlanResult result;
+    result.result = generateDeliveryPlan(depot, deliveries, result.commands, result.totalDistanceTravelled);
+    co_return result;
+}
+
+void DeliveryPlannerImpl::generateLegCommands(const list<StreetSegment>& route, vector<DeliveryCommand>& commands) const
+{
+        // Process each StreetSegment. (If the delivery location is AT the previous location, there are none.)
+    list<StreetSegment>::const_iterator itr = route.begin();
+    while (itr != route.end())
     {
-            // Generate a sequence of DeliveryCommands representing instructions to the delivery robot
-        list<StreetSegment> currRoute = totalRoute[i];      // Current route for the current movement to delivery or depot
+            // First, make a proceed command for the start of this Street
+        const StreetSegment& seg = *itr;
+        DeliveryCommand proceedCmd;
+        string proceedDir = angleToProceedDir(angleOfLine(seg));       // Compute direction for Proceed command
+        double dist = distanceEarthMiles(seg.start, seg.end);   // Compute distance for first segment of Proceed command
+        proceedCmd.initAsProceedCommand(proceedDir, seg.name, dist);
+        itr++;                                                  // Move on to the next segment
             
-            // If the delivery location is AT the depot, simply generate a delivery command instantly and continue
-        if (currRoute.empty())
+        while ( itr != route.end() && itr->name == seg.name )   // While the next Segment is the same street
         {
-            DeliveryCommand instantDeliver;
-            instantDeliver.initAsDeliverCommand(delivery->item);
-            commands.push_back(instantDeliver);
-            delivery++;
-            continue;
+            double nextDist = distanceEarthMiles(itr->start, itr->end);     // Calculate the next segment's distance
+            proceedCmd.increaseDistance(nextDist);      // Increase the distance of the Proceed command
+            itr++;                                      // Move on to the next segment
         }
             
-            // Process each StreetSegment
-        list<StreetSegment>::iterator itr = currRoute.begin();
-        while (itr != currRoute.end())
+        commands.push_back(proceedCmd);                 // Push the Proceed command onto commands
+              // Check that we have not reached the destination already before turning
+        if (itr != route.end())
         {
-                // First, make a proceed command for the start of this Street
-            StreetSegment seg = *itr;
-            string currStreet = seg.name;
-            DeliveryCommand proceedCmd;
-            string proceedDir = angleToProceedDir(angleOfLine(seg));       // Compute direction for Proceed command
-            double dist = distanceEarthMiles(seg.start, seg.end);   // Compute distance for first segment of Proceed command
-            proceedCmd.initAsProceedCommand(proceedDir, seg.name, dist);
-                
-            if ( itr++ == currRoute.end() ) { break; }              // Move on to the next segment. Break if we are done.
+                // After the while loop, we are done with the street, so now we need to turn
+            list<StreetSegment>::const_iterator previous = std::prev(itr);   // Iterator to previous StreetSegment (last of Proceed command
+            double turnAngle = angleBetween2Lines(*previous, *itr);
+                // If the angle is not between 1 and 359, inclusive, do not generate a turn command, and instead just proceed
+            if (turnAngle < 1 || turnAngle > 359)
+                continue;               // By continuing, we are starting the while loop over, thus generating a Proceed
                 
-            while ( itr->name == proceedCmd.streetName() )          // While the next Segment is the same street
-            {
-                double nextDist = distanceEarthMiles(itr->start, itr->end);     // Calculate the next segment's distance
-                proceedCmd.increaseDistance(nextDist);      // Increase the distance of the Proceed command
-                if ( itr++ == currRoute.end() ) { break; }  // Move on to the next segment. Break if we are done.
-            }
-                
-            commands.push_back(proceedCmd);                 // Push the Proceed command onto commands
-                  // Check that we have not reached the destination already before turning
-            if (itr != currRoute.end())
-            {
-                    // After the while loop, we are done with the street, so now we need to turn
-                list<StreetSegment>::iterator previous = std::prev(itr);   // Iterator to previous StreetSegment (last of Proceed command
-                double turnAngle = angleBetween2Lines(*previous, *itr);
-                    // If the angle is not between 1 and 359, inclusive, do not generate a turn command, and instead just proceed
-                if (turnAngle < 1 || turnAngle > 359)
-                    continue;               // By continuing, we are starting the while loop over, thus generating a Proceed
-                    
-                    // If we did not continue in the if statement above, generate a turn command
-                DeliveryCommand turnCmd;
-                string turnDir = angleToTurnDir(turnAngle);
-                turnCmd.initAsTurnCommand(turnDir, itr->name);
-                commands.push_back(turnCmd);
-            }
-        }
-            
-            // Check to see that the robot is delivering something and not returning to the depot...
-        if (i != totalRoute.size() - 1)
-        {
-                // Generate a deliver DeliveryCommand indicating that a food item should be delivered at that location
-            DeliveryCommand deliver;
-            deliver.initAsDeliverCommand(optimizedDeliveries[i].item);
-            commands.push_back(deliver);
+                // If we did not continue in the if statement above, generate a turn command
+            DeliveryCommand turnCmd;
+            string turnDir = angleToTurnDir(turnAngle);
+            turnCmd.initAsTurnCommand(turnDir, itr->name);
+            commands.push_back(turnCmd);
         }
-        delivery++;         // Move on to the next delivery
     }
-    
-    return DELIVERY_SUCCESS;        // If we got here, we successfully delivered
 }
 
 string DeliveryPlannerImpl::angleToProceedDir(double angle) const
@@ -211,3 +519,35 @@ DeliveryResult DeliveryPlanner::generateDeliveryPlan(
 {
     return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
 }
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    const function<void(const DeliveryCommand&)>& onCommand,
+    double& totalDistanceTravelled) const
+{
+    return m_impl->generateDeliveryPlan(depot, deliveries, onCommand, totalDistanceTravelled);
+}
+
+Task<PlanResult> DeliveryPlanner::generateDeliveryPlanAsync(GeoCoord depot, vector<DeliveryRequest> deliveries) const
+{
+    return m_impl->generateDeliveryPlanAsync(depot, move(deliveries));
+}
+
+void DeliveryPlanner::setRouteCache(shared_ptr<const RouteCache> cache)
+{
+    m_impl->setRouteCache(cache);
+}
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryPlan& plan) const
+{
+    return m_impl->generateDeliveryPlan(depot, deliveries, plan);
+}
+
+DeliveryResult DeliveryPlanner::insertDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery, size_t earliestStop) const
+{
+    return m_impl->insertDelivery(plan, delivery, earliestStop);
+}
@@ -0,0 +1,242 @@
+// EdgeWeights.cpp
+// Edge cost overlays and their ALT (landmark) customization
+
+#include "EdgeWeights.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+using namespace std;
+
+namespace
+{
+
+  // Incoming edges of every node, as (from node, cost) pairs in CSR form, for searching toward a landmark.
+  // Like costsFrom, it prices closed edges as if open (see customize).
+struct ReverseGraph
+{
+    vector<int> first;
+    vector<pair<int, double>> edges;
+};
+
+ReverseGraph reverseGraph(const StreetMapSnapshot& map, const EdgeWeights& weights)
+{
+    ReverseGraph rev;
+    int n = map.nodeCount();
+    rev.first.assign(n + 1, 0);
+    for (int u = 0; u < n; u++)
+    {
+        for (const GraphEdge& e : map.edges(u))
+            rev.first[e.to + 1]++;
+    }
+    for (int v = 0; v < n; v++)
+        rev.first[v + 1] += rev.first[v];
+    rev.edges.resize(rev.first[n]);
+    vector<int> next(rev.first.begin(), rev.first.end() - 1);
+    for (int u = 0; u < n; u++)
+    {
+        for (const GraphEdge& e : map.edges(u))
+            rev.edges[next[e.to]++] = make_pair(u, weights.cost(e));
+    }
+    return rev;
+}
+
+typedef pair<double, int> QueueEntry;   // (cost so far, node)
+
+  // One-to-all Dijkstra from source, forward over the map's edges at the overlay's costs, closed or not;
+  // unreachable nodes keep infinity
+void costsFrom(const StreetMapSnapshot& map, const EdgeWeights& weights, int source, vector<double>& dist)
+{
+    dist.assign(map.nodeCount(), EdgeWeights::CLOSED);
+    priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> open;
+    dist[source] = 0;
+    open.push(QueueEntry(0, source));
+    while (!open.empty())
+    {
+        QueueEntry top = open.top();
+        open.pop();
+        if (top.first > dist[top.second])
+            continue;       // Stale entry; the node was settled with a smaller cost
+        for (const GraphEdge& e : map.edges(top.second))
+        {
+            double c = weights.cost(e);
+            if (top.first + c < dist[e.to])
+            {
+                dist[e.to] = top.first + c;
+                open.push(QueueEntry(dist[e.to], e.to));
+            }
+        }
+    }
+}
+
+  // All-to-one Dijkstra toward target, over the reversed edges
+void costsTo(const ReverseGraph& rev, int target, vector<double>& dist)
+{
+    dist.assign(rev.first.size() - 1, EdgeWeights::CLOSED);
+    priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> open;
+    dist[target] = 0;
+    open.push(QueueEntry(0, target));
+    while (!open.empty())
+    {
+        QueueEntry top = open.top();
+        open.pop();
+        if (top.first > dist[top.second])
+            continue;
+        for (int i = rev.first[top.second]; i < rev.first[top.second + 1]; i++)
+        {
+            int from = rev.edges[i].first;
+            double c = top.first + rev.edges[i].second;
+            if (c < dist[from])
+            {
+                dist[from] = c;
+                open.push(QueueEntry(c, from));
+            }
+        }
+    }
+}
+
+}  // namespace
+
+EdgeWeights::EdgeWeights(const StreetMapSnapshot& map)
+ : m_costs(map.edgeIdLimit(), CLOSED), m_lengths(map.edgeIdLimit(), 0), m_minCostPerMile(1),
+   m_fingerprint(map.fingerprint()), m_loadVersion(map.loadVersion())
+{
+    for (int n = 0; n < map.nodeCount(); n++)
+    {
+        for (const GraphEdge& e : map.edges(n))
+        {
+            m_costs[e.id] = e.length;
+            m_lengths[e.id] = e.length;
+        }
+    }
+}
+
+shared_ptr<EdgeWeights> EdgeWeights::fromSpeeds(const StreetMapSnapshot& map,
+                                                const function<double(const GraphEdge& edge)>& milesPerHour)
+{
+    shared_ptr<EdgeWeights> weights = make_shared<EdgeWeights>(map);
+    weights->m_minCostPerMile = CLOSED;
+    for (int n = 0; n < map.nodeCount(); n++)
+    {
+        for (const GraphEdge& e : map.edges(n))
+        {
+            double mph = milesPerHour(e);
+            weights->m_costs[e.id] = mph > 0 ? 60 * e.length / mph : CLOSED;
+            if (mph > 0)
+                weights->m_minCostPerMile = min(weights->m_minCostPerMile, 60 / mph);
+        }
+    }
+    if (weights->m_minCostPerMile == CLOSED)
+        weights->m_minCostPerMile = 0;      // Every edge is closed
+    return weights;
+}
+
+void EdgeWeights::setCost(int edgeId, double cost)
+{
+    if (edgeId < 0 || edgeId >= (int) m_costs.size())
+        return;
+    m_costs[edgeId] = cost;
+      // Keep minCostPerMile a lower bound; raising costs merely leaves it a little loose
+    if (m_lengths[edgeId] > 0 && cost / m_lengths[edgeId] < m_minCostPerMile)
+        m_minCostPerMile = cost / m_lengths[edgeId];
+}
+
+bool EdgeWeights::setCost(const StreetMapSnapshot& map, const GeoCoord& start, const GeoCoord& end, double cost)
+{
+    int from = map.nodeId(start);
+    int to = map.nodeId(end);
+    if (from < 0 || to < 0)
+        return false;
+    bool found = false;
+    for (const GraphEdge& e : map.edges(from))
+    {
+        if (e.to == to)
+        {
+            setCost(e.id, cost);
+            found = true;
+        }
+    }
+    return found;
+}
+
+void EdgeWeights::customize(const StreetMapSnapshot& map, int landmarkCount)
+{
+    TRACE_SCOPE("EdgeWeights::customize");
+    int n = map.nodeCount();
+    shared_ptr<Landmarks> landmarks = make_shared<Landmarks>();
+    landmarks->count = 0;
+    landmarks->nodeCount = n;
+    landmarks->edgeIdLimit = map.edgeIdLimit();
+    if (n == 0 || landmarkCount <= 0)
+    {
+        m_landmarks = landmarks;
+        return;
+    }
+    landmarks->fromLandmark.reserve((size_t) landmarkCount * n);
+    landmarks->toLandmark.reserve((size_t) landmarkCount * n);
+      // Street closures (StreetMap::closeSegment) are ignored: a closure only raises costs, so landmark costs
+      // computed with every street open stay lower bounds while it lasts and after reopenSegment lifts it. Computing
+      // them with a closed street left out would overestimate once it reopens, and A* would miss routes through it.
+    ReverseGraph rev = reverseGraph(map, *this);
+
+      // Farthest-point selection: each new landmark is the node farthest from all the landmarks chosen so far,
+      // which spreads them around the edge of the map where they give the tightest bounds
+    vector<double> dist;
+    costsFrom(map, *this, 0, dist);
+    vector<double> nearestLandmark(n, CLOSED);
+    vector<double> toDist;
+    for (int l = 0; l < landmarkCount; l++)
+    {
+        const vector<double>& spread = (l == 0) ? dist : nearestLandmark;
+        int landmark = -1;
+        for (int v = 0; v < n; v++)
+        {
+            if (spread[v] != CLOSED && (landmark < 0 || spread[v] > spread[landmark]))
+                landmark = v;
+        }
+        if (landmark < 0 || (l > 0 && spread[landmark] == 0))
+            break;      // Every reachable node already is a landmark
+
+        costsFrom(map, *this, landmark, dist);
+        costsTo(rev, landmark, toDist);
+        for (int v = 0; v < n; v++)
+        {
+            landmarks->fromLandmark.push_back(dist[v]);
+            landmarks->toLandmark.push_back(toDist[v]);
+            nearestLandmark[v] = min(nearestLandmark[v], dist[v]);
+        }
+        landmarks->count++;
+    }
+    m_landmarks = landmarks;
+}
+
+void EdgeWeights::customizeFrom(const EdgeWeights& lowerBounds)
+{
+    m_landmarks = lowerBounds.m_landmarks;
+}
+
+double EdgeWeights::landmarkBound(int from, int to) const
+{
+    const Landmarks* landmarks = m_landmarks.get();
+    if (landmarks == nullptr || from >= landmarks->nodeCount || to >= landmarks->nodeCount)
+        return 0;
+
+      // By the triangle inequality, for every landmark L:
+      //   cost(from, to) >= cost(L, to) - cost(L, from)   and   cost(from, to) >= cost(from, L) - cost(to, L)
+      // Each cost was summed in a different order than the router sums the same route, so it may be off by a few
+      // units in the last place of the larger one; take that off the difference so the bound never overestimates.
+    auto difference = [](double a, double b) {
+        if (isinf(a) || isinf(b))
+            return 0.0;
+        return a - b - 4 * numeric_limits<double>::epsilon() * max(a, b);
+    };
+    double best = 0;
+    for (int l = 0; l < landmarks->count; l++)
+    {
+        size_t base = (size_t) l * landmarks->nodeCount;
+        best = max(best, difference(landmarks->fromLandmark[base + to], landmarks->fromLandmark[base + from]));
+        best = max(best, difference(landmarks->toLandmark[base + from], landmarks->toLandmark[base + to]));
+    }
+    return best;
+}
@@ -0,0 +1,95 @@
+// EdgeWeights.h
+// A per-edge cost overlay for PointToPointRouter, e.g. travel time under a time-of-day speed profile,
+// congestion, or closures, swapped in with PointToPointRouter::setEdgeWeights without touching the StreetMap.
+//
+// Costs are indexed by edge id (see StreetMapSnapshot.h), which stays valid across live map updates until the next
+// StreetMap::load. Edges added after the overlay was built cost their length times minCostPerMile(). An overlay is
+// stamped with the load it was built on, and routers ignore it (routing by distance) on any other: after a reload,
+// or on a tiled map once tiles have been loaded or evicted, the same ids name different edges. They do not rebuild
+// it, as they cannot tell what the costs were for; a query that ignored it says so in RouteStats::weightsIgnored,
+// and PointToPointRouter::edgeWeightsUsable() tells whether the current map still fits it, so that the caller can
+// build a new overlay on that map and set it.
+//
+// customize() is the optional preprocessing step: it picks a few landmark nodes and stores every node's cost to and
+// from each of them (ALT). The router turns those into a much tighter A* lower bound than straight-line distance.
+// Re-customizing takes a couple of Dijkstra searches per landmark, i.e. seconds even on large maps, so a new
+// overlay can be customized off to the side while routers keep using the old one. Landmark costs stay valid lower
+// bounds for any overlay whose costs are all >= the customized ones, so one customization of free-flow costs can
+// serve every congestion overlay built on top of it (see customizeFrom).
+
+#ifndef EDGEWEIGHTS_INCLUDED
+#define EDGEWEIGHTS_INCLUDED
+
+#include "StreetMapSnapshot.h"
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class EdgeWeights
+{
+  public:
+    static constexpr double CLOSED = std::numeric_limits<double>::infinity();
+
+      // Every edge costs its length in miles, which is what the router minimizes without an overlay
+    explicit EdgeWeights(const StreetMapSnapshot& map);
+
+      // Travel time in minutes, given each edge's speed in miles per hour (0 closes the edge)
+    static std::shared_ptr<EdgeWeights> fromSpeeds(const StreetMapSnapshot& map,
+                                                   const std::function<double(const GraphEdge& edge)>& milesPerHour);
+
+      // Whether this overlay's edge ids mean the same edges on map, i.e. map builds on the load it was built on
+    bool usableWith(const StreetMapSnapshot& map) const
+    {
+        return map.fingerprint() == m_fingerprint && map.loadVersion() == m_loadVersion;
+    }
+
+    double cost(const GraphEdge& edge) const
+    {
+        return edge.id < (int) m_costs.size() ? m_costs[edge.id] : edge.length * m_minCostPerMile;
+    }
+
+      // Sets the cost of one directed edge (CLOSED makes it impassable). Lowering a cost after customize() calls
+      // for another customize(). The GeoCoord version returns false if no such segment exists.
+    void setCost(int edgeId, double cost);
+    bool setCost(const StreetMapSnapshot& map, const GeoCoord& start, const GeoCoord& end, double cost);
+
+      // The smallest cost per mile of any edge, so straight-line miles times this never overestimates a route's cost
+    double minCostPerMile() const { return m_minCostPerMile; }
+
+      // ALT preprocessing against this overlay's own costs
+    void customize(const StreetMapSnapshot& map, int landmarkCount = 8);
+      // Reuses another overlay's landmarks; valid only if every cost here is >= the corresponding cost there
+    void customizeFrom(const EdgeWeights& lowerBounds);
+    bool isCustomized() const { return m_landmarks != nullptr; }
+      // Whether the landmarks bound routes on map: false once segments have been added since customization, as a
+      // new segment may be a shortcut the landmark costs know nothing about. The router then bounds by crow.
+    bool landmarksCover(const StreetMapSnapshot& map) const
+    {
+        return m_landmarks != nullptr && map.nodeCount() <= m_landmarks->nodeCount &&
+               map.edgeIdLimit() <= m_landmarks->edgeIdLimit;
+    }
+
+      // A lower bound on the cost of getting from node `from` to node `to` (0 if nothing better is known), valid
+      // on maps the landmarks cover
+    double landmarkBound(int from, int to) const;
+
+  private:
+    struct Landmarks
+    {
+        int count;
+        int nodeCount;
+        int edgeIdLimit;                    // The map's StreetMapSnapshot::edgeIdLimit() when customized
+        std::vector<double> fromLandmark;   // [l * nodeCount + n] = cost from landmark l to node n
+        std::vector<double> toLandmark;     // [l * nodeCount + n] = cost from node n to landmark l
+    };
+
+    std::vector<double> m_costs;        // Indexed by edge id
+    std::vector<double> m_lengths;      // Miles, indexed by edge id
+    double m_minCostPerMile;
+    std::shared_ptr<const Landmarks> m_landmarks;
+    uint64_t m_fingerprint;             // Of the map built on, see usableWith
+    long long m_loadVersion;
+};
+
+#endif // EDGEWEIGHTS_INCLUDED
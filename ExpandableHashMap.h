@@ -1,8 +1,40 @@
 // ExpandableHashMap.h
+#ifndef EXPANDABLEHASHMAP_INCLUDED
+#define EXPANDABLEHASHMAP_INCLUDED
+
+#include <chrono>
+#include <cstddef>
 #include <iostream>
+#include <vector>
 using namespace std;
 const int DEFAULT_NUM_BUCKETS = 8;
 
+  // Snapshot of a hashmap's occupancy, for tuning the hasher and maximum load factor
+struct HashMapStats
+{
+    int numItems = 0;
+    int numBuckets = 0;
+    double loadFactor = 0;          // numItems / numBuckets
+    double maxLoadFactor = 0;       // The hashmap expands once loadFactor would exceed this
+    int emptyBuckets = 0;
+    int longestChain = 0;           // Most Nodes in any one bucket
+    double averageProbeLength = 0;  // Average Nodes visited by a successful find
+    vector<int> chainLengths;       // chainLengths[k] = number of buckets holding exactly k Nodes
+    int rehashCount = 0;            // Expansions since construction or the last reset()
+    double rehashSeconds = 0;       // Total time spent in those expansions
+    size_t bytesAllocated = 0;      // Bucket array plus Nodes (not counting memory the keys/values own themselves)
+};
+
+inline ostream& operator<<(ostream& os, const HashMapStats& s)
+{
+    os << s.numItems << " items " << s.numBuckets << " buckets, load " << s.loadFactor << " (max " << s.maxLoadFactor
+       << "), " << s.emptyBuckets << " empty, longest chain " << s.longestChain << ", avg probe " << s.averageProbeLength
+       << ", " << s.rehashCount << " rehashes in " << s.rehashSeconds * 1e3 << " ms, " << s.bytesAllocated << " bytes; chains:";
+    for (size_t k = 0; k < s.chainLengths.size(); k++)
+        os << " " << k << ":" << s.chainLengths[k];
+    return os;
+}
+
 template<typename KeyType, typename ValueType>
 class ExpandableHashMap
 {
@@ -11,6 +43,7 @@ public:
     ~ExpandableHashMap();
     void reset();
     int size() const;
+    HashMapStats stats() const;     // Walks every bucket, so O(buckets + items); not for hot paths
     void associate(const KeyType& key, const ValueType& value);
 
       // for a map that can't be modified, return a pointer to const ValueType
@@ -22,6 +55,17 @@ public:
         return const_cast<ValueType*>(const_cast<const ExpandableHashMap*>(this)->find(key));
     }
     
+      // Calls visit(key, value) for every association, in bucket order
+    template<typename Visitor>
+    void forEach(Visitor visit) const
+    {
+        for (int i = 0; i < m_numBuckets; i++)
+        {
+            for (Node* cur = m_hashMap[i]; cur != nullptr; cur = cur->next)
+                visit(cur->key, cur->value);
+        }
+    }
+    
       // C++11 syntax for preventing copying and assignment
     ExpandableHashMap(const ExpandableHashMap&) = delete;
     ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
@@ -38,6 +82,8 @@ private:
     int m_numBuckets;        // Number of buckets
     int m_maxNumItems;       // Maximum # of associations, dependent on max load factor. Helps to ensure the load factor is not exceeded
     int m_numItems;          // The number of associations in the hashmap
+    int m_rehashCount;       // Number of expandHashMap calls since construction or the last reset
+    double m_rehashSeconds;  // Time spent in those calls
     
     Node** m_hashMap;        // Array of Node pointers
     
@@ -66,6 +112,8 @@ ExpandableHashMap<KeyType, ValueType>::ExpandableHashMap(double maximumLoadFacto
 
     m_maxNumItems = (int) (m_maxLoadFactor * m_numBuckets);
     m_numItems = 0;     // Starts with no items
+    m_rehashCount = 0;
+    m_rehashSeconds = 0;
 }
 
 template<typename KeyType, typename ValueType>
@@ -88,15 +136,47 @@ void ExpandableHashMap<KeyType, ValueType>::reset()
 
     m_maxNumItems = (int) (m_maxLoadFactor * m_numBuckets);
     m_numItems = 0;
+    m_rehashCount = 0;
+    m_rehashSeconds = 0;
 }
 
 template<typename KeyType, typename ValueType>
 int ExpandableHashMap<KeyType, ValueType>::size() const
 {
-    cout << m_numItems << " items " << m_numBuckets << " buckets" << endl;
     return m_numItems;
 }
 
+template<typename KeyType, typename ValueType>
+HashMapStats ExpandableHashMap<KeyType, ValueType>::stats() const
+{
+    HashMapStats s;
+    s.numItems = m_numItems;
+    s.numBuckets = m_numBuckets;
+    s.loadFactor = (double) m_numItems / m_numBuckets;
+    s.maxLoadFactor = m_maxLoadFactor;
+    s.rehashCount = m_rehashCount;
+    s.rehashSeconds = m_rehashSeconds;
+    s.bytesAllocated = m_numBuckets * sizeof(Node*) + m_numItems * sizeof(Node);
+    
+      // The k-th Node of a chain takes k probes to find, so a chain of length n costs n(n+1)/2 probes in total
+    long long totalProbes = 0;
+    for (int i = 0; i < m_numBuckets; i++)
+    {
+        int length = 0;
+        for (Node* cur = m_hashMap[i]; cur != nullptr; cur = cur->next)
+            length++;
+        if (length >= (int) s.chainLengths.size())
+            s.chainLengths.resize(length + 1, 0);
+        s.chainLengths[length]++;
+        if (length > s.longestChain)
+            s.longestChain = length;
+        totalProbes += (long long) length * (length + 1) / 2;
+    }
+    s.emptyBuckets = s.chainLengths.empty() ? 0 : s.chainLengths[0];
+    s.averageProbeLength = m_numItems == 0 ? 0 : (double) totalProbes / m_numItems;
+    return s;
+}
+
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
 {
@@ -140,6 +220,7 @@ void ExpandableHashMap<KeyType, ValueType>::freeMemory()
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::expandHashMap()
 {
+    chrono::steady_clock::time_point rehashStart = chrono::steady_clock::now();
     int newNumBuckets = m_numBuckets * 2;   // The new hashmap will have twice as many buckets
     m_maxNumItems = (int) (m_maxLoadFactor * newNumBuckets);
     
@@ -191,6 +272,9 @@ void ExpandableHashMap<KeyType, ValueType>::expandHashMap()
     freeMemory();               // Free the old hashmap
     m_numBuckets = newNumBuckets;
     m_hashMap = newHashMap;     // Reassigns the pointer of old hashmap to new hashmap
+    
+    m_rehashCount++;
+    m_rehashSeconds += chrono::duration<double>(chrono::steady_clock::now() - rehashStart).count();
 }
 
 template<typename KeyType, typename ValueType>
@@ -248,3 +332,5 @@ unsigned int ExpandableHashMap<KeyType, ValueType>::getBucketNumber(const KeyTyp
     unsigned int bucketNum = hasher(key);
     return bucketNum % numBuckets;
 }
+
+#endif // EXPANDABLEHASHMAP_INCLUDED
@@ -0,0 +1,21 @@
+// FleetPlan.h
+// The result of DeliveryOptimizer::optimizeFleet: a depot's deliveries split among several robots.
+//
+// Each delivery is one unit of load, so a robot's capacity is the number of deliveries it can carry on one tour.
+// Tours are optimized by crow distance (as optimizeDeliveryOrder is); plan each one with DeliveryPlanner.
+
+#ifndef FLEETPLAN_INCLUDED
+#define FLEETPLAN_INCLUDED
+
+#include "provided.h"
+#include <vector>
+
+struct FleetPlan
+{
+    std::vector<std::vector<DeliveryRequest>> tours;    // tours[k]: robot k's deliveries in order (maybe none)
+    std::vector<double> crowDistances;                  // Each tour's crow distance, depot to depot
+    double totalCrowDistance = 0;
+    double longestCrowDistance = 0;
+};
+
+#endif // FLEETPLAN_INCLUDED
@@ -0,0 +1,121 @@
+// Isochrone.cpp
+// Bounded one-to-all searches for StreetMap::reachableWithin; see Isochrone.h.
+
+#include "Isochrone.h"
+#include "OpenList.h"
+#include "StreetMapSnapshot.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <limits>
+
+using namespace std;
+
+const GeoCoord& Isochrone::node(size_t i) const
+{
+    return m_map->coord(m_nodes[i]);
+}
+
+bool Isochrone::reachable(const GeoCoord& gc) const
+{
+    double miles;
+    return reachable(gc, miles);
+}
+
+bool Isochrone::reachable(const GeoCoord& gc, double& miles) const
+{
+    if (m_map == nullptr)
+        return false;
+    unordered_map<int, double>::const_iterator it = m_milesByNode.find(m_map->nodeId(gc));
+    if (it == m_milesByNode.end())
+        return false;
+    miles = it->second;
+    return true;
+}
+
+void Isochrone::filter(const vector<DeliveryRequest>& orders, vector<DeliveryRequest>& inside, vector<DeliveryRequest>* outside) const
+{
+    inside.clear();
+    if (outside != nullptr)
+        outside->clear();
+    for (const DeliveryRequest& order : orders)
+    {
+        if (reachable(order.location))
+            inside.push_back(order);
+        else if (outside != nullptr)
+            outside->push_back(order);
+    }
+}
+
+void Isochrone::search(const StreetMapSnapshot& map, int source, double maxMiles)
+{
+    TRACE_SCOPE("Isochrone::search");
+    const double INF = numeric_limits<double>::infinity();
+    vector<double> cost(map.nodeCount(), INF);
+    vector<bool> settled(map.nodeCount(), false);
+    m_maxMiles = maxMiles;
+    m_nodes.clear();
+    m_miles.clear();
+
+      // Dijkstra, except that nothing beyond maxMiles is ever pushed, so the search dies out at the boundary
+    RadixHeapQueue toDo;
+    cost[source] = 0;
+    toDo.push(0, source);
+    while (!toDo.empty())
+    {
+        int curr = toDo.pop();
+        if (settled[curr])
+            continue;
+        settled[curr] = true;
+        m_nodes.push_back(curr);
+        m_miles.push_back(cost[curr]);
+
+        for (const GraphEdge& e : map.edges(curr))
+        {
+            if (e.closed)
+                continue;
+            double newCost = cost[curr] + e.length;
+            if (newCost <= maxMiles && newCost < cost[e.to])
+            {
+                cost[e.to] = newCost;
+                toDo.push(newCost, e.to);
+            }
+        }
+    }
+
+    m_milesByNode.clear();
+    m_milesByNode.reserve(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); i++)
+        m_milesByNode.emplace(m_nodes[i], m_miles[i]);
+}
+
+DeliveryResult Isochrone::compute(const shared_ptr<const StreetMapSnapshot>& map, const GeoCoord& origin, double maxMiles, Isochrone& result)
+{
+    int source = map->nodeId(origin);
+    if (source < 0)
+        return BAD_COORD;
+    result.m_map = map;
+    result.m_origin = origin;
+    result.search(*map, source, maxMiles);
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult Isochrone::computeAll(const shared_ptr<const StreetMapSnapshot>& map, const vector<GeoCoord>& origins, double maxMiles, vector<Isochrone>& results)
+{
+    TRACE_SCOPE("Isochrone::computeAll");
+    vector<int> sources(origins.size());
+    for (size_t i = 0; i < origins.size(); i++)
+    {
+        sources[i] = map->nodeId(origins[i]);
+        if (sources[i] < 0)
+            return BAD_COORD;
+    }
+
+      // Searches are independent, one per pool job
+    results.assign(origins.size(), Isochrone());
+    ThreadPool::shared().parallelFor(origins.size(), [&](size_t i) {
+        results[i].m_map = map;
+        results[i].m_origin = origins[i];
+        results[i].search(*map, sources[i], maxMiles);
+    });
+    return DELIVERY_SUCCESS;
+}
@@ -0,0 +1,63 @@
+// Isochrone.h
+// The service area of an origin (usually a depot): every intersection reachable from it within some number of
+// road miles, with the distance to each. StreetMap::reachableWithin computes them, one bounded Dijkstra search per
+// origin, several origins in parallel on the shared thread pool.
+//
+//   vector<Isochrone> areas;
+//   streetMap.reachableWithin(depots, 2.5, areas);     // Everything within 2.5 miles of each depot
+//   areas[0].filter(orders, servable, &tooFar);        // Sort an order batch before planning
+//
+// Distances are outbound (origin to node) over open segments of the map version the search ran on; an isochrone
+// keeps that version alive, so it stays self-consistent whatever happens to the map afterwards.
+
+#ifndef ISOCHRONE_INCLUDED
+#define ISOCHRONE_INCLUDED
+
+#include "provided.h"
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class StreetMapSnapshot;
+
+class Isochrone
+{
+  public:
+    const GeoCoord& origin() const { return m_origin; }
+    double maxMiles() const { return m_maxMiles; }
+
+      // The reachable intersections in order of increasing distance (the origin first)
+    std::size_t size() const { return m_nodes.size(); }
+    const GeoCoord& node(std::size_t i) const;
+    double miles(std::size_t i) const { return m_miles[i]; }
+
+      // Whether gc is within maxMiles of the origin, and if so how far it is (O(1))
+    bool reachable(const GeoCoord& gc) const;
+    bool reachable(const GeoCoord& gc, double& miles) const;
+
+      // Splits orders into those whose location is reachable and (if outside is not nullptr) those that are not,
+      // keeping their order
+    void filter(const std::vector<DeliveryRequest>& orders, std::vector<DeliveryRequest>& inside,
+                std::vector<DeliveryRequest>* outside = nullptr) const;
+
+      // The searches behind StreetMap::reachableWithin. Each returns BAD_COORD, computing nothing, if an origin is
+      // not on map.
+    static DeliveryResult compute(const std::shared_ptr<const StreetMapSnapshot>& map, const GeoCoord& origin,
+                                  double maxMiles, Isochrone& result);
+    static DeliveryResult computeAll(const std::shared_ptr<const StreetMapSnapshot>& map, const std::vector<GeoCoord>& origins,
+                                     double maxMiles, std::vector<Isochrone>& results);
+
+  private:
+    std::shared_ptr<const StreetMapSnapshot> m_map;
+    GeoCoord m_origin;
+    double m_maxMiles = 0;
+    std::vector<int> m_nodes;                       // Node ids, in the order the search settled them
+    std::vector<double> m_miles;
+    std::unordered_map<int, double> m_milesByNode;  // Node id -> miles, for reachable()
+
+      // Bounded Dijkstra from node source; fills everything but m_map and m_origin
+    void search(const StreetMapSnapshot& map, int source, double maxMiles);
+};
+
+#endif // ISOCHRONE_INCLUDED
@@ -0,0 +1,307 @@
+// MapGenerator.cpp
+// Generates synthetic map data and delivery files, in the same formats as mapdata.txt and deliveries.txt,
+// so the loader, hash map, router and optimizer can be exercised at much larger scales than Westwood.
+//
+// Usage: mapgen [--type=grid|random] [--segments=n] [--stops=n] [--seed=n] [--map=file] [--deliveries=file]
+//        mapgen --split=mapdata.txt [--tile-dir=directory] [--tile-degrees=x]
+//
+//   grid    A jittered rectangular street grid: east-west "Streets" crossed by north-south "Avenues",
+//           with a small fraction of blocks missing.
+//   random  A random planar road network: the same jittered lattice, but every cell may also get one
+//           diagonal footpath and a larger fraction of segments is removed. Jitter is kept below half the
+//           lattice spacing and each cell gets at most one diagonal, so no two segments ever cross.
+//
+// The depot and every delivery stop are drawn from the largest connected part of the generated network, so
+// every generated delivery can actually be routed. The same seed always produces the same files.
+//
+// --split cuts an existing map data file into tiles of x degrees (0.01 unless given) for StreetMap::loadTiles,
+// writing them and their index.txt into the tile directory ("tiles" unless given, created if need be); see MapTiles.h.
+
+#include "MapTiles.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+
+const double ORIGIN_LAT = 34.0400000;       // South-west corner, just south of Westwood
+const double ORIGIN_LON = -118.4800000;
+const double SPACING = 0.0005;              // About 55 meters between intersections
+const double MAX_JITTER = 0.00015;          // Must stay below SPACING / 2 to keep the network planar
+
+struct Options
+{
+    string type = "grid";
+    long long segments = 100000;
+    int stops = 1000;
+    unsigned int seed = 32;
+    string mapFile = "synthetic_mapdata.txt";
+    string deliveriesFile = "synthetic_deliveries.txt";
+    string splitFile;               // Split this map into tiles instead of generating one
+    string tileDirectory = "tiles";
+    double tileDegrees = 0.01;
+};
+
+struct Segment
+{
+    int from;
+    int to;
+};
+
+struct Street
+{
+    string name;
+    vector<Segment> segments;
+};
+
+  // Union-find over node indices, used to pick delivery stops that are reachable from the depot
+class DisjointSets
+{
+  public:
+    DisjointSets(int n) : m_parent(n), m_size(n, 1)
+    {
+        for (int i = 0; i < n; i++)
+            m_parent[i] = i;
+    }
+
+    int find(int x)
+    {
+        while (m_parent[x] != x)
+        {
+            m_parent[x] = m_parent[m_parent[x]];    // Path halving
+            x = m_parent[x];
+        }
+        return x;
+    }
+
+    void unite(int a, int b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return;
+        if (m_size[a] < m_size[b])
+            swap(a, b);
+        m_parent[b] = a;
+        m_size[a] += m_size[b];
+    }
+
+    int size(int x) { return m_size[find(x)]; }
+
+  private:
+    vector<int> m_parent;
+    vector<int> m_size;
+};
+
+string ordinal(int n)
+{
+    int lastTwo = n % 100;
+    const char* suffix = "th";
+    if (lastTwo < 11 || lastTwo > 13)
+    {
+        switch (n % 10)
+        {
+          case 1: suffix = "st"; break;
+          case 2: suffix = "nd"; break;
+          case 3: suffix = "rd"; break;
+        }
+    }
+    return to_string(n) + suffix;
+}
+
+bool parseArgs(int argc, char* argv[], Options& opts)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == string::npos)
+            return false;
+        string key = arg.substr(2, eq - 2);
+        string value = arg.substr(eq + 1);
+        if (key == "type" && (value == "grid" || value == "random"))
+            opts.type = value;
+        else if (key == "segments")
+            opts.segments = stoll(value);
+        else if (key == "stops")
+            opts.stops = stoi(value);
+        else if (key == "seed")
+            opts.seed = (unsigned int) stoul(value);
+        else if (key == "map")
+            opts.mapFile = value;
+        else if (key == "deliveries")
+            opts.deliveriesFile = value;
+        else if (key == "split")
+            opts.splitFile = value;
+        else if (key == "tile-dir")
+            opts.tileDirectory = value;
+        else if (key == "tile-degrees")
+            opts.tileDegrees = stod(value);
+        else
+            return false;
+    }
+    return opts.segments > 0 && opts.stops >= 0 && opts.tileDegrees > 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opts;
+    if (!parseArgs(argc, argv, opts))
+    {
+        cerr << "Usage: " << argv[0] << " [--type=grid|random] [--segments=n] [--stops=n] [--seed=n]"
+             << " [--map=file] [--deliveries=file]" << endl;
+        cerr << "       " << argv[0] << " --split=mapdata.txt [--tile-dir=directory] [--tile-degrees=x]" << endl;
+        return 1;
+    }
+
+    if (!opts.splitFile.empty())
+    {
+        error_code ignored;
+        filesystem::create_directories(opts.tileDirectory, ignored);
+        MapTileIndex index;
+        if (!splitMapFile(opts.splitFile, opts.tileDirectory, opts.tileDegrees) ||
+            !index.read((filesystem::path(opts.tileDirectory) / "index.txt").string()))
+        {
+            cerr << "Unable to split " << opts.splitFile << " into " << opts.tileDirectory << endl;
+            return 1;
+        }
+        long long segments = 0;
+        for (const MapTile& tile : index.tiles)
+            segments += tile.segments;
+        cout << opts.tileDirectory << ": " << index.tiles.size() << " tiles of " << opts.tileDegrees << " degrees, "
+             << segments << " tile segments (crossing segments are in two tiles)" << endl;
+        return 0;
+    }
+
+    mt19937 rng(opts.seed);
+    uniform_real_distribution<double> jitter(-MAX_JITTER, MAX_JITTER);
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    bool isRandom = (opts.type == "random");
+    double dropRate = isRandom ? 0.10 : 0.02;
+    double diagonalRate = isRandom ? 0.35 : 0.0;
+
+      // An n x n lattice has 2n(n-1) grid segments, plus about diagonalRate * (n-1)^2 diagonals
+    double perSide = sqrt((double) opts.segments / (2.0 * (1.0 - dropRate) + diagonalRate));
+    int n = max(2, (int) ceil(perSide));
+
+      // Node coordinates are formatted once, so every segment touching a node uses identical text
+    vector<string> coordText(n * n);
+    for (int r = 0; r < n; r++)
+    {
+        for (int c = 0; c < n; c++)
+        {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%.7f %.7f", ORIGIN_LAT + r * SPACING + jitter(rng),
+                     ORIGIN_LON + c * SPACING + jitter(rng));
+            coordText[r * n + c] = buf;
+        }
+    }
+
+    vector<Street> streets;
+    DisjointSets components(n * n);
+    long long totalSegments = 0;
+    auto addSegment = [&](Street& street, int from, int to) {
+        if (coin(rng) < dropRate)
+            return;
+        street.segments.push_back(Segment{ from, to });
+        components.unite(from, to);
+        totalSegments++;
+    };
+
+    for (int r = 0; r < n; r++)
+    {
+        Street street;
+        street.name = ordinal(r + 1) + " Street";
+        for (int c = 0; c + 1 < n; c++)
+            addSegment(street, r * n + c, r * n + c + 1);
+        streets.push_back(street);
+    }
+    for (int c = 0; c < n; c++)
+    {
+        Street street;
+        street.name = ordinal(c + 1) + " Avenue";
+        for (int r = 0; r + 1 < n; r++)
+            addSegment(street, r * n + c, (r + 1) * n + c);
+        streets.push_back(street);
+    }
+    if (diagonalRate > 0)
+    {
+          // One path name per row of cells; each cell gets at most one of its two diagonals
+        for (int r = 0; r + 1 < n; r++)
+        {
+            Street street;
+            street.name = ordinal(r + 1) + " Street Footpath";
+            for (int c = 0; c + 1 < n; c++)
+            {
+                if (coin(rng) >= diagonalRate)
+                    continue;
+                if (coin(rng) < 0.5)
+                    addSegment(street, r * n + c, (r + 1) * n + c + 1);
+                else
+                    addSegment(street, r * n + c + 1, (r + 1) * n + c);
+            }
+            if (!street.segments.empty())
+                streets.push_back(street);
+        }
+    }
+
+    ofstream mapOut(opts.mapFile);
+    if (!mapOut)
+    {
+        cerr << "Error: Cannot open " << opts.mapFile << " for writing!" << endl;
+        return 1;
+    }
+    for (size_t i = 0; i < streets.size(); i++)
+    {
+        if (streets[i].segments.empty())
+            continue;
+        mapOut << streets[i].name << '\n' << streets[i].segments.size() << '\n';
+        for (size_t j = 0; j < streets[i].segments.size(); j++)
+        {
+            const Segment& s = streets[i].segments[j];
+            mapOut << coordText[s.from] << ' ' << coordText[s.to] << '\n';
+        }
+    }
+    mapOut.close();
+
+      // Pick the depot and the stops from the largest connected component
+    int best = 0;
+    for (int i = 1; i < n * n; i++)
+    {
+        if (components.size(i) > components.size(best))
+            best = i;
+    }
+    int root = components.find(best);
+    vector<int> reachable;
+    for (int i = 0; i < n * n; i++)
+    {
+        if (components.find(i) == root)
+            reachable.push_back(i);
+    }
+
+    ofstream deliveriesOut(opts.deliveriesFile);
+    if (!deliveriesOut)
+    {
+        cerr << "Error: Cannot open " << opts.deliveriesFile << " for writing!" << endl;
+        return 1;
+    }
+    uniform_int_distribution<size_t> pick(0, reachable.size() - 1);
+    deliveriesOut << coordText[reachable[pick(rng)]] << '\n';
+    for (int i = 0; i < opts.stops; i++)
+        deliveriesOut << coordText[reachable[pick(rng)]] << ":Package " << (i + 1) << '\n';
+    deliveriesOut.close();
+
+    cout << opts.mapFile << ": " << totalSegments << " segments, " << streets.size() << " streets, "
+         << n * n << " lattice nodes (" << reachable.size() << " in the largest component)" << endl;
+    cout << opts.deliveriesFile << ": depot + " << opts.stops << " stops" << endl;
+    return 0;
+}
@@ -0,0 +1,100 @@
+// MapTiles.cpp
+// Reading tile indexes and cutting map data files into tiles; see MapTiles.h.
+
+#include "MapTiles.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <utility>
+using namespace std;
+
+bool MapTileIndex::read(const string& indexFile)
+{
+    ifstream infile(indexFile);
+    if (!infile)
+        return false;
+    string keyword;
+    double degrees;
+    if (!(infile >> keyword >> degrees) || keyword != "tiles" || !(degrees > 0))
+        return false;
+
+    filesystem::path directory = filesystem::path(indexFile).parent_path();
+    vector<MapTile> read;
+    MapTile tile;
+    while (infile >> tile.row >> tile.col >> tile.segments >> tile.file)
+    {
+        tile.file = (directory / tile.file).string();
+        read.push_back(tile);
+    }
+    if (!infile.eof())
+        return false;
+    tileDegrees = degrees;
+    tiles.swap(read);
+    return true;
+}
+
+bool splitMapFile(const string& mapFile, const string& directory, double tileDegrees)
+{
+    ifstream infile(mapFile);
+    if (!infile || !(tileDegrees > 0))
+        return false;
+    MapTileIndex grid;
+    grid.tileDegrees = tileDegrees;
+
+      // Each tile's segments in file order, with the street each belongs to
+    vector<string> streets;
+    map<pair<int, int>, vector<pair<int, string>>> tiles;
+    string line;
+    while (getline(infile, line))
+    {
+        if (find_if(line.begin(), line.end(), [](char c) { return isalpha((unsigned char) c); }) != line.end())
+        {
+            istringstream iss(line);
+            string name, word;
+            while (iss >> word)
+                name += (name.empty() ? "" : " ") + word;
+            streets.push_back(name);
+            continue;
+        }
+        istringstream iss(line);
+        string startLat, startLon, endLat, endLon;
+        if (streets.empty() || !(iss >> startLat >> startLon >> endLat >> endLon))
+            continue;       // A segment count, or a segment before any street name
+        pair<int, int> ends[2] = {
+            { grid.rowOf(stod(startLat)), grid.colOf(stod(startLon)) },
+            { grid.rowOf(stod(endLat)), grid.colOf(stod(endLon)) }
+        };
+        string segment = startLat + " " + startLon + " " + endLat + " " + endLon;
+        tiles[ends[0]].emplace_back((int) streets.size() - 1, segment);
+        if (ends[1] != ends[0])
+            tiles[ends[1]].emplace_back((int) streets.size() - 1, segment);
+    }
+
+    ofstream index((filesystem::path(directory) / "index.txt").string());
+    if (!index)
+        return false;
+    index.precision(15);
+    index << "tiles " << tileDegrees << "\n";
+    for (const auto& [cell, segments] : tiles)
+    {
+        string fileName = "tile_" + to_string(cell.first) + "_" + to_string(cell.second) + ".txt";
+        ofstream tileFile((filesystem::path(directory) / fileName).string());
+        if (!tileFile)
+            return false;
+          // A street's segments are consecutive, as in the source file: its name, how many, then the segments
+        for (size_t i = 0; i < segments.size(); )
+        {
+            size_t last = i;
+            while (last < segments.size() && segments[last].first == segments[i].first)
+                last++;
+            tileFile << streets[segments[i].first] << "\n" << last - i << "\n";
+            for (; i < last; i++)
+                tileFile << segments[i].second << "\n";
+        }
+        index << cell.first << " " << cell.second << " " << segments.size() << " " << fileName << "\n";
+    }
+    return (bool) index;
+}
@@ -0,0 +1,47 @@
+// MapTiles.h
+// Map data cut into square tiles, for regions too large to load whole. splitMapFile writes each tile as its own
+// mapdata.txt-format file, plus an index:
+//
+//   tiles 0.01                      tile size in degrees (of latitude and of longitude)
+//   row col segments file           one line per non-empty tile; the tile covers latitudes [row, row + 1) * size
+//   ...                             and longitudes [col, col + 1) * size; file is relative to the index's directory
+//
+// A segment is written to the tile of each of its ends, so a tile holds every segment touching an intersection in it
+// and a segment that crosses a tile boundary is in both tiles. Its owner is the tile its start lies in; a map built
+// from several tiles takes each segment from its owner, or from the other tile when the owner is not loaded.
+//
+// StreetMap::loadTiles reads the index and loads tiles as queries need them (see provided.h).
+
+#ifndef MAPTILES_INCLUDED
+#define MAPTILES_INCLUDED
+
+#include "provided.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+struct MapTile
+{
+    int row;
+    int col;
+    long long segments;     // Segments in the tile's file, crossing ones included
+    std::string file;       // Path of the tile's map data file
+};
+
+struct MapTileIndex
+{
+    double tileDegrees = 0;
+    std::vector<MapTile> tiles;
+
+    int rowOf(double latitude) const { return (int) std::floor(latitude / tileDegrees); }
+    int colOf(double longitude) const { return (int) std::floor(longitude / tileDegrees); }
+
+      // Replaces this index with the one in indexFile; returns false if it cannot be read or is malformed
+    bool read(const std::string& indexFile);
+};
+
+  // Cuts mapFile into tiles of tileDegrees on a side, writing them and index.txt into directory (which must exist).
+  // Returns false if mapFile cannot be read or a file cannot be written.
+bool splitMapFile(const std::string& mapFile, const std::string& directory, double tileDegrees);
+
+#endif // MAPTILES_INCLUDED
@@ -0,0 +1,169 @@
+// OpenList.h
+// Min-priority queues of (key, node) for the router's open list (the Queue policy of RouteSearch, see RouteSearch.h).
+// A node may be pushed more than once; the search skips the copies it has already settled, so no decrease-key.
+//
+//   BinaryHeapQueue      std::priority_queue, the baseline
+//   QuaternaryHeapQueue  a 4-ary heap in one array: half the depth, and a node's children share a cache line
+//   RadixHeapQueue       a monotone radix heap over the keys' bit patterns: pushes are O(1), and each entry moves
+//                        down at most 64 buckets over its lifetime. Keys must never be less than the last key popped,
+//                        which holds for Dijkstra and for A* with a consistent heuristic.
+//
+// All three take non-negative double keys and have the same interface: push(key, node), pop() (returns the node
+// with the smallest key), empty() and size(). Among equal keys the order nodes come out in may differ.
+
+#ifndef OPENLIST_INCLUDED
+#define OPENLIST_INCLUDED
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+class BinaryHeapQueue
+{
+  public:
+    void push(double key, int node) { m_heap.push(Entry(key, node)); }
+    int pop()
+    {
+        int node = m_heap.top().second;
+        m_heap.pop();
+        return node;
+    }
+    bool empty() const { return m_heap.empty(); }
+    std::size_t size() const { return m_heap.size(); }
+
+  private:
+    typedef std::pair<double, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> m_heap;
+};
+
+class QuaternaryHeapQueue
+{
+  public:
+    void push(double key, int node)
+    {
+          // Sift the new entry up from the end, moving parents down into the hole
+        std::size_t hole = m_heap.size();
+        m_heap.push_back(Entry(key, node));
+        while (hole > 0)
+        {
+            std::size_t parent = (hole - 1) / 4;
+            if (!(key < m_heap[parent].first))
+                break;
+            m_heap[hole] = m_heap[parent];
+            hole = parent;
+        }
+        m_heap[hole] = Entry(key, node);
+    }
+
+    int pop()
+    {
+        int node = m_heap[0].second;
+        Entry last = m_heap.back();
+        m_heap.pop_back();
+        std::size_t n = m_heap.size();
+        if (n == 0)
+            return node;
+
+          // Sift the last entry down from the root, moving the smallest child up into the hole
+        std::size_t hole = 0;
+        for (;;)
+        {
+            std::size_t child = 4 * hole + 1;
+            if (child >= n)
+                break;
+            std::size_t smallest = child;
+            std::size_t end = (child + 4 < n) ? child + 4 : n;
+            for (std::size_t c = child + 1; c < end; c++)
+            {
+                if (m_heap[c].first < m_heap[smallest].first)
+                    smallest = c;
+            }
+            if (!(m_heap[smallest].first < last.first))
+                break;
+            m_heap[hole] = m_heap[smallest];
+            hole = smallest;
+        }
+        m_heap[hole] = last;
+        return node;
+    }
+
+    bool empty() const { return m_heap.empty(); }
+    std::size_t size() const { return m_heap.size(); }
+
+  private:
+    typedef std::pair<double, int> Entry;
+    std::vector<Entry> m_heap;
+};
+
+class RadixHeapQueue
+{
+  public:
+    RadixHeapQueue() : m_last(0), m_size(0) {}
+
+    void push(double key, int node)
+    {
+        uint64_t bits = bitsOf(key);
+          // Rounding in a heuristic can put a key a hair below one already popped; treat it as equal
+        if (bits < m_last)
+            bits = m_last;
+        m_buckets[bucketOf(bits)].push_back(Entry(bits, node));
+        m_size++;
+    }
+
+    int pop()
+    {
+        if (m_buckets[0].empty())
+        {
+              // Move the lowest non-empty bucket's smallest key up to last; everything else in that bucket now
+              // differs from last in a lower bit, so it spreads into the buckets below
+            int b = 1;
+            while (m_buckets[b].empty())
+                b++;
+            std::vector<Entry>& from = m_buckets[b];
+            uint64_t smallest = from[0].first;
+            for (const Entry& e : from)
+            {
+                if (e.first < smallest)
+                    smallest = e.first;
+            }
+            m_last = smallest;
+            for (const Entry& e : from)
+                m_buckets[bucketOf(e.first)].push_back(e);
+            from.clear();
+        }
+        int node = m_buckets[0].back().second;
+        m_buckets[0].pop_back();
+        m_size--;
+        return node;
+    }
+
+    bool empty() const { return m_size == 0; }
+    std::size_t size() const { return m_size; }
+
+  private:
+    typedef std::pair<uint64_t, int> Entry;
+    std::vector<Entry> m_buckets[65];   // Bucket b > 0 holds keys whose highest bit differing from last is bit b - 1
+    uint64_t m_last;                    // The last key popped (as bits)
+    std::size_t m_size;
+
+      // Non-negative doubles order the same way as their bit patterns do as unsigned integers
+    static uint64_t bitsOf(double key)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return bits;
+    }
+
+    int bucketOf(uint64_t bits) const
+    {
+        uint64_t differing = bits ^ m_last;
+        return 64 - std::countl_zero(differing);     // 0 when bits == last
+    }
+};
+
+#endif // OPENLIST_INCLUDED
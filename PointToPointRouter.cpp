@@ -1,8 +1,22 @@
 #include "provided.h"
-#include "ExpandableHashMap.h"
+#include "AsyncPlanning.h"
+#include "EdgeWeights.h"
+#include "OpenList.h"
+#include "RouteCache.h"
+#include "RoutePath.h"
+#include "RouteSearch.h"
+#include "RouteStats.h"
+#include "StreetMapSnapshot.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "TurnCosts.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <list>
-#include <queue>
-#include <set>
+#include <memory>
+#include <utility>
+#include <vector>
 using namespace std;
 
 class PointToPointRouterImpl
@@ -14,237 +28,548 @@ class PointToPointRouterImpl
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
-        double& totalDistanceTravelled) const;
+        double& totalDistanceTravelled,
+        RouteStats* stats) const;
+    DeliveryResult generatePointToPointPath(const GeoCoord& start, const GeoCoord& end, RoutePath& path, RouteStats* stats) const;
+    DeliveryResult generateDistanceMatrix(const vector<GeoCoord>& points, vector<double>& matrix) const;
+    Task<RouteResult> generatePointToPointRouteAsync(GeoCoord start, GeoCoord end) const;
+    void setEdgeWeights(shared_ptr<const EdgeWeights> weights);
+    bool edgeWeightsUsable() const;
+    void setTurnCosts(shared_ptr<const TurnCosts> turnCosts);
+    void setRouteCache(shared_ptr<const RouteCache> cache);
   private:
     const StreetMap* m_streetMap;
-    ExpandableHashMap<GeoCoord, GeoCoord>* m_path;  // Contains associations from GeoCoord -> GeoCoord that make up the route
-    
-        // Finds the optimal route from start to end in StreetSegments and store it in route
-    bool findOptimalRoute(
+    shared_ptr<const EdgeWeights> m_weights;    // nullptr to route by distance. Swapped with atomic_store
+    shared_ptr<const TurnCosts> m_turnCosts;    // nullptr for the plain (node-based) search. Swapped with atomic_store
+    shared_ptr<const RouteCache> m_routeCache;  // Persisted routes to try before searching, or nullptr. Swapped with atomic_store
+
+    static constexpr double TILE_MARGIN_MILES = 0.25;   // On a tiled map, how far around a query's points tiles are loaded first
+
+      // The query itself, instantiated once per stats policy (see RouteStats.h) so uninstrumented queries pay nothing.
+      // On a tiled map it routes on the tiles around start and end, widening the area while that finds no route.
+    template<typename Stats>
+    DeliveryResult generateRoute(
         const GeoCoord& start,
         const GeoCoord& end,
-        list<StreetSegment>& route,
-        double& totalDistanceTravelled) const;
-        
-      // Auxiliary function for findOptimalRoute
-    void explore(set<GeoCoord>& explored, queue<GeoCoord>& toDo, const StreetSegment& seg) const;
-    
-      // Recreates the route history segment by segment, adds these segments to route
-    void recreateRouteHistory(list<StreetSegment>& route, const GeoCoord& start, const GeoCoord& end, double& totalDistanceTravelled) const;
-    
-      // Quicksort the vector of StreetSegments in order of increasing distance from the end GeoCoord
-    void sortSegments(vector<StreetSegment>& adjacentSegs, int first, int last, const GeoCoord& end) const;
-    
-      // Auxiliary function for paritioning the vector for the QuickSort function sortSegments
-    int partition(vector<StreetSegment>& adjacentSegs, int low, int high, const GeoCoord& end) const;
-    
-      // Auxiliary function for swapping two StreetSegement's in a vector
-    void swapSegInVector(vector<StreetSegment>& adjacentSegs, int index1, int index2) const;
+        RoutePath& path,
+        Stats& stats) const;
+      // The query on one version of the map
+    template<typename Stats>
+    DeliveryResult generateRouteOn(
+        const shared_ptr<const StreetMapSnapshot>& map,
+        const GeoCoord& start,
+        const GeoCoord& end,
+        RoutePath& path,
+        Stats& stats) const;
+
+        // A* search for the cheapest route from node start to node end; stores its hops in path if there is one.
+        // Picks the RouteSearch instantiation for the weights in use.
+    template<typename Stats>
+    static bool findOptimalRoute(
+        const shared_ptr<const StreetMapSnapshot>& map,
+        const EdgeWeights* weights,
+        int start,
+        int end,
+        RoutePath& path,
+        Stats& stats);
+
+        // Turn-aware variant: searches over directed segments, so each move can be charged for the turn it makes
+    template<typename Stats>
+    bool findOptimalRouteWithTurns(
+        const StreetMapSnapshot& map,
+        const EdgeWeights* weights,
+        const TurnCosts& turnCosts,
+        int start,
+        int end,
+        RoutePath& path,
+        Stats& stats) const;
+
+      // Rebuilds the cached route from node start to node end, if the cache has one and every segment on it is open
+    static bool routeFromCache(
+        const StreetMapSnapshot& map,
+        const RouteCache& cache,
+        int start,
+        int end,
+        RoutePath& routePath);
+
+      // One row of the distance matrix: a Dijkstra search from source that stops once every point has been reached.
+      // Points at node u are firstPoint[u], nextPoint[firstPoint[u]], ... (-1 ends the list).
+    static void distancesFrom(
+        const StreetMapSnapshot& map,
+        const EdgeWeights* weights,
+        int source,
+        const vector<int>& firstPoint,
+        const vector<int>& nextPoint,
+        double* row);
+
+      // The weights in use, or nullptr if there are none or they were built on other map data than map (the query
+      // then goes by distance, and stats records that it did)
+    template<typename Stats>
+    shared_ptr<const EdgeWeights> weightsFor(const StreetMapSnapshot& map, Stats& stats) const
+    {
+        shared_ptr<const EdgeWeights> weights = atomic_load(&m_weights);
+        if (weights == nullptr || weights->usableWith(map))
+            return weights;
+        stats.ignoredWeights();
+        return nullptr;
+    }
+      // Cost of travelling an edge: its length, or its cost in the overlay
+    static double edgeCost(const EdgeWeights* weights, const GraphEdge& e)
+    {
+        return weights == nullptr ? e.length : weights->cost(e);
+    }
 };
 
   // PRECONDITION: sm points to a fully-constructed StreetMap object containing loaded street map data
 PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm)
 {
     m_streetMap = sm;
-    m_path = new ExpandableHashMap<GeoCoord, GeoCoord>;
 }
 
 PointToPointRouterImpl::~PointToPointRouterImpl()
 {
-    delete m_path;
+}
+
+void PointToPointRouterImpl::setEdgeWeights(shared_ptr<const EdgeWeights> weights)
+{
+    atomic_store(&m_weights, weights);
+}
+
+bool PointToPointRouterImpl::edgeWeightsUsable() const
+{
+    shared_ptr<const EdgeWeights> weights = atomic_load(&m_weights);
+    return weights == nullptr || weights->usableWith(*m_streetMap->snapshot());
+}
+
+void PointToPointRouterImpl::setTurnCosts(shared_ptr<const TurnCosts> turnCosts)
+{
+    atomic_store(&m_turnCosts, turnCosts);
+}
+
+void PointToPointRouterImpl::setRouteCache(shared_ptr<const RouteCache> cache)
+{
+    atomic_store(&m_routeCache, cache);
 }
 
 DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
-        double& totalDistanceTravelled) const
+        double& totalDistanceTravelled,
+        RouteStats* stats) const
 {
-      // Check if the start or end GeoCoord's are valid / within the mapping data
-    vector<StreetSegment> startSegments;
-    vector<StreetSegment> endSegments;
-    if (! (m_streetMap->getSegmentsThatStartWith(start, startSegments) && m_streetMap->getSegmentsThatStartWith(end, endSegments)))
-        return BAD_COORD;
-    
-      // If the start and ending GeoCoord's are the exact same
-    if (start == end)
+    RoutePath path;
+    DeliveryResult result = generatePointToPointPath(start, end, path, stats);
+    if (result == DELIVERY_SUCCESS)
+    {
+        route.clear();
+        path.appendTo(route);
+        totalDistanceTravelled = path.miles();
+    }
+    return result;
+}
+
+DeliveryResult PointToPointRouterImpl::generatePointToPointPath(const GeoCoord& start, const GeoCoord& end, RoutePath& path, RouteStats* stats) const
+{
+    if (stats == nullptr)
+    {
+        NoRouteStats noStats;
+        return generateRoute(start, end, path, noStats);
+    }
+
+      // Stats describe this query only; callers aggregate with RouteStats::operator+=
+    *stats = RouteStats();
+    stats->queries = 1;
+    CollectRouteStats collect(*stats);
+    return generateRoute(start, end, path, collect);
+}
+
+DeliveryResult PointToPointRouterImpl::generateDistanceMatrix(const vector<GeoCoord>& points, vector<double>& matrix) const
+{
+    TRACE_SCOPE("PointToPointRouter::generateDistanceMatrix");
+
+      // On a tiled map, the tiles around the points; widened, like a route's, while some pair has no route there
+    for (double margin = TILE_MARGIN_MILES; ; margin *= 2)
     {
-          // Clear the route parameter. Do not add anything to route as there is no route needed
-        while (!route.empty())
+        shared_ptr<const StreetMapSnapshot> map = m_streetMap->snapshotCovering(points, margin);
+        NoRouteStats noStats;
+        shared_ptr<const EdgeWeights> weights = weightsFor(*map, noStats);
+        size_t n = points.size();
+        vector<int> nodes(n);
+        for (size_t i = 0; i < n; i++)
         {
-            list<StreetSegment>::iterator itr = route.begin();
-            itr = route.erase(itr);
+            nodes[i] = map->nodeId(points[i]);
+            if (nodes[i] < 0 || map->edges(nodes[i]).empty())
+                return BAD_COORD;
         }
-        totalDistanceTravelled = 0;     // The distance travelled for this case is clearly 0
-        return DELIVERY_SUCCESS;        // A path was found (no path needed)
+        vector<int> firstPoint(map->nodeCount(), -1);
+        vector<int> nextPoint(n, -1);
+        for (size_t i = n; i-- > 0; )
+        {
+            nextPoint[i] = firstPoint[nodes[i]];
+            firstPoint[nodes[i]] = (int) i;
+        }
+
+          // Rows are independent searches, one per pool job
+        matrix.assign(n * n, numeric_limits<double>::infinity());
+        ThreadPool::shared().parallelFor(n, [&](size_t i) {
+            distancesFrom(*map, weights.get(), nodes[i], firstPoint, nextPoint, &matrix[i * n]);
+        });
+        if (map->complete())
+            return DELIVERY_SUCCESS;
+
+          // Widen only while some pair without a route could still be joined by tiles not loaded yet
+        vector<int> extends(n, -1);     // Per point: 1 if its component may extend, 0 if not, -1 if not yet known
+        auto mayExtend = [&](size_t i) {
+            if (extends[i] < 0)
+                extends[i] = map->componentMayExtend(nodes[i]) ? 1 : 0;
+            return extends[i] == 1;
+        };
+        bool widen = false;
+        for (size_t k = 0; k < n * n && !widen; k++)
+            widen = matrix[k] == numeric_limits<double>::infinity() && mayExtend(k / n) && mayExtend(k % n);
+        if (!widen)
+            return DELIVERY_SUCCESS;
     }
-    
-      // Determine the optimal route
-    if (findOptimalRoute(start, end, route, totalDistanceTravelled))
-        return DELIVERY_SUCCESS;
-    else
-        return NO_ROUTE;
 }
 
-  // Return true if a route is found. Otherwise, return false.
-  // PRECONDITION: GeoCoord's start and end are valid
-bool PointToPointRouterImpl::findOptimalRoute(
-        const GeoCoord& start,
-        const GeoCoord& end,
-        list<StreetSegment>& route,
-        double& totalDistanceTravelled) const
+bool PointToPointRouterImpl::routeFromCache(
+        const StreetMapSnapshot& map,
+        const RouteCache& cache,
+        int start,
+        int end,
+        RoutePath& routePath)
 {
-    totalDistanceTravelled = 0;             // Reset total distance travelled
-    queue<GeoCoord> toDo;
-    vector<StreetSegment> adjacentSegs;     // Contains adjacent StreetSegments to GeoCoord curr (in the while loop)
-    set<GeoCoord> explored;                 // Contains GeoCoord's that have been explored already
-    
-      // Process starting GeoCoord start
-    toDo.push(start);
-    explored.insert(start);
+    double miles;
+    const uint32_t* path;
+    size_t pathLength;
+    if (!cache.find(start, end, miles, path, pathLength) || pathLength < 2 ||
+        path[0] != (uint32_t) start || path[pathLength - 1] != (uint32_t) end)
+        return false;
 
-    while ( ! toDo.empty() )
+    vector<RoutePath::Hop> hops;
+    hops.reserve(pathLength - 1);
+    double distance = 0;
+    for (size_t i = 1; i < pathLength; i++)
     {
-        GeoCoord curr = toDo.front();
-        toDo.pop();
+        if (path[i] >= (uint32_t) map.nodeCount())
+            return false;
+          // The shortest open segment between the two nodes: the edge a distance search arrives by, which is the
+          // hop RoutePath records for it
+        const GraphEdge* segment = nullptr;
+        for (const GraphEdge& e : map.edges(path[i - 1]))
+        {
+            if (e.to == (int) path[i] && !e.closed && (segment == nullptr || e.length < segment->length))
+                segment = &e;
+        }
+        if (segment == nullptr)
+            return false;
+        hops.push_back(RoutePath::Hop{ (int) path[i - 1], (int) path[i], segment->name, segment->length });
+        distance += segment->length;
+    }
+    routePath.m_hops.swap(hops);
+    routePath.m_miles = distance;
+    return true;
+}
+
+void PointToPointRouterImpl::distancesFrom(
+        const StreetMapSnapshot& map,
+        const EdgeWeights* weights,
+        int source,
+        const vector<int>& firstPoint,
+        const vector<int>& nextPoint,
+        double* row)
+{
+    const double INF = numeric_limits<double>::infinity();
+    int nodeCount = map.nodeCount();
+    vector<double> cost(nodeCount, INF);
+    vector<double> miles(nodeCount, 0);     // Length of the cheapest route found to each node
+    vector<bool> settled(nodeCount, false);
+    int remaining = (int) nextPoint.size();
 
-          // If we have reached the end, return true
-        if (curr == end)
+    RadixHeapQueue toDo;    // (cost, node)
+    cost[source] = 0;
+    toDo.push(0, source);
+    while (!toDo.empty() && remaining > 0)
+    {
+        int curr = toDo.pop();
+        if (settled[curr])
+            continue;
+        settled[curr] = true;
+        for (int p = firstPoint[curr]; p >= 0; p = nextPoint[p])
         {
-              // Clear the route parameter before re-creating it
-            while (!route.empty())
-            {
-                list<StreetSegment>::iterator itr = route.begin();
-                itr = route.erase(itr);
-            }
-            totalDistanceTravelled = 0;     // Reset the total distance travelled
-            recreateRouteHistory(route, start, end, totalDistanceTravelled);   // Creates the path and puts it into route
-            return true;
+            row[p] = miles[curr];
+            remaining--;
         }
-        
-          // Call explore on all adjacent StreetSegments to GeoCoord curr
-        m_streetMap->getSegmentsThatStartWith(curr, adjacentSegs);      // Erases contents of adjacentSegs vector
-        
-          // Sort the vector of adjancent StreetSegments to optimize the total route distance
-        sortSegments(adjacentSegs, 0, adjacentSegs.size() - 1, end);
-        
-        for (vector<StreetSegment>::iterator itr = adjacentSegs.begin(); itr != adjacentSegs.end(); itr++)
+
+        for (const GraphEdge& e : map.edges(curr))
         {
-            GeoCoord start = itr->start;
-            GeoCoord end = itr->end;
-              // If GeoCoord start has already been explored, do nothing.
-            set<GeoCoord>::iterator it = explored.find(end);
-            if (it == explored.end())      // If we enter this for loop, then gc was not found in explored
+            if (e.closed)
+                continue;
+            double newCost = cost[curr] + edgeCost(weights, e);
+            if (newCost < cost[e.to])
             {
-                  // Otherwise, push it onto queue of GeoCoord's toDo
-                toDo.push(end);
-                explored.insert(end);        // Mark GeoCoord gc as explored
-                m_path->associate(end, start);
+                cost[e.to] = newCost;
+                miles[e.to] = miles[curr] + e.length;
+                toDo.push(newCost, e.to);
             }
         }
     }
-    
-    return false;       // No route found
 }
 
-void PointToPointRouterImpl::explore(set<GeoCoord>& explored, queue<GeoCoord>& toDo, const StreetSegment& seg) const
+Task<RouteResult> PointToPointRouterImpl::generatePointToPointRouteAsync(GeoCoord start, GeoCoord end) const
 {
-    GeoCoord start = seg.start;
-    GeoCoord end = seg.end;
-      // If GeoCoord start has already been explored, do nothing.
-    set<GeoCoord>::iterator itr = explored.find(end);
-    if (itr == explored.end())      // If we enter this for loop, then gc was not found in explored
-    {
-          // Otherwise, push it onto queue of GeoCoord's toDo
-        toDo.push(end);
-        explored.insert(end);        // Mark GeoCoord gc as explored
-        m_path->associate(end, start);
-    }
+    co_await resumeOn(ThreadPool::shared());
+    RouteResult result;
+    result.result = generatePointToPointRoute(start, end, result.route, result.totalDistanceTravelled, nullptr);
+    co_return result;
 }
 
-void PointToPointRouterImpl::recreateRouteHistory(list<StreetSegment>& route, const GeoCoord& start, const GeoCoord& end, double& totalDistanceTravelled) const
+template<typename Stats>
+DeliveryResult PointToPointRouterImpl::generateRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        RoutePath& path,
+        Stats& stats) const
 {
-      // Trace our hashmap of GeoCoord's -> GeoCoord's, finding the route from start to end, BACKWARDS!
-    const GeoCoord* endingG = &end;
-    const GeoCoord* startingG;
-    startingG = m_path->find(*endingG);
-    
-      // Get the street name by finding all segments that start with startingG, and finding the street with the same
-      // starting and ending GeoCoord's, and extracting the streetname
-    vector<StreetSegment> possibleSegs;
-    string streetName;
-    
-      // While we have not reached the start... (we are retracing steps backwards)
-    while (*endingG != const_cast<const GeoCoord&>(start))
+    TRACE_SCOPE("PointToPointRouter::generatePointToPointRoute");
+    vector<GeoCoord> ends{ start, end };
+    double crowMiles = distanceEarthMiles(start, end);
+    double margin = TILE_MARGIN_MILES;
+    for (;;)
     {
-        m_streetMap->getSegmentsThatStartWith(*startingG, possibleSegs);
-        for (vector<StreetSegment>::iterator itr = possibleSegs.begin(); itr != possibleSegs.end(); itr++)
+        shared_ptr<const StreetMapSnapshot> map = m_streetMap->snapshotCovering(ends, margin);
+        bool byDistance = weightsFor(*map, stats) == nullptr && atomic_load(&m_turnCosts) == nullptr;
+        DeliveryResult result = generateRouteOn(map, start, end, path, stats);
+        if (map->complete() || result == BAD_COORD)
+            return result;
+        if (result == NO_ROUTE)
         {
-              // Check to see if the StreetSegment has the same ending GeoCoord (it must already have the same starting)
-            if (*endingG == itr->end && *startingG == itr->start)
-            {
-                streetName = itr->name;
-                break;
-            }
+              // More tiles can only help if both ends' components go on into tiles not loaded yet. Otherwise one of
+              // them is here whole without the other end in it, and there is no route on the whole map either.
+            if (!map->componentMayExtend(map->nodeId(start)) || !map->componentMayExtend(map->nodeId(end)))
+                return NO_ROUTE;
+            margin *= 2;
+            continue;
         }
-        
-          // Checks for error- ensures that streetName was assigned and we found a matching street
-        if (streetName == "")
+          // Any shorter route lies in the ellipse of points whose crow miles to start and to end add up to less than
+          // this route's, and all of that is within its semi-minor axis of the line between them. If the tiles loaded
+          // reach that far, the route is the shortest on the whole map. (With weights or turn costs there is no such
+          // bound, and the first route found stands.)
+        double needed = sqrt(max(0.0, path.miles() * path.miles() - crowMiles * crowMiles)) / 2;
+        if (!byDistance || needed <= margin)
+            return result;
+        margin = needed;
+    }
+}
+
+template<typename Stats>
+DeliveryResult PointToPointRouterImpl::generateRouteOn(
+        const shared_ptr<const StreetMapSnapshot>& map,
+        const GeoCoord& start,
+        const GeoCoord& end,
+        RoutePath& path,
+        Stats& stats) const
+{
+    stats.startPhase();
+
+      // The whole query runs against one version of the map (and of the weights), even if either is updated meanwhile
+    shared_ptr<const EdgeWeights> weights = weightsFor(*map, stats);
+    shared_ptr<const TurnCosts> turnCosts = atomic_load(&m_turnCosts);
+    shared_ptr<const RouteCache> cache = atomic_load(&m_routeCache);
+
+      // Check if the start or end GeoCoord's are valid / within the mapping data
+    stats.hashLookup();
+    stats.hashLookup();
+    int startNode = map->nodeId(start);
+    int endNode = map->nodeId(end);
+    bool validCoords = startNode >= 0 && endNode >= 0 && !map->edges(startNode).empty() && !map->edges(endNode).empty();
+    stats.endValidate();
+    if (!validCoords)
+        return BAD_COORD;
+
+      // If the start and ending GeoCoord's are the exact same
+    if (start == end)
+    {
+          // Clear the path parameter. Do not add anything to it as there is no route needed
+        path.clear();
+        path.m_map = map;
+        return DELIVERY_SUCCESS;        // A path was found (no path needed)
+    }
+
+      // Endpoints in different connected parts of the map: nothing to search (labels are computed at load)
+    if (!map->sameComponent(startNode, endNode))
+    {
+        stats.endSearch();
+        return NO_ROUTE;
+    }
+
+      // Cached routes are shortest by distance on the map as loaded, so they only answer plain queries on that map
+    if (cache != nullptr && weights == nullptr && turnCosts == nullptr && cache->usableWith(*map))
+    {
+        bool cached = routeFromCache(*map, *cache, startNode, endNode, path);
+        stats.endSearch();
+        if (cached)
         {
-            cerr << "nani! streetName was not assigned, meaning the street was not found";
-            return;
+            path.m_map = map;
+            return DELIVERY_SUCCESS;
         }
-        
-          // Push this street segment onto our route list
-        route.push_front(StreetSegment(*startingG, *endingG, streetName));
-        totalDistanceTravelled += distanceEarthMiles(*startingG, *endingG);    // Add to the distance travelled for the route
-          // Update starting and ending for the next iteration of the loop
-        endingG = startingG;                    // New endingG is the old starting location
-        startingG = m_path->find(*startingG);
     }
+
+      // Determine the optimal route
+    bool found;
+    if (turnCosts != nullptr)
+        found = findOptimalRouteWithTurns(*map, weights.get(), *turnCosts, startNode, endNode, path, stats);
+    else
+        found = findOptimalRoute(map, weights.get(), startNode, endNode, path, stats);
+    if (found)
+    {
+        path.m_map = map;       // Keeps the names and coordinates the hops refer to alive
+        return DELIVERY_SUCCESS;
+    }
+    else
+        return NO_ROUTE;
 }
 
-void PointToPointRouterImpl::sortSegments(vector<StreetSegment>& adjacentSegs, int first, int last, const GeoCoord& end) const
+  // Return true if a route is found. Otherwise, return false.
+  // PRECONDITION: nodes start and end are on the map
+template<typename Stats>
+bool PointToPointRouterImpl::findOptimalRoute(
+        const shared_ptr<const StreetMapSnapshot>& map,
+        const EdgeWeights* weights,
+        int start,
+        int end,
+        RoutePath& path,
+        Stats& stats)
 {
-      // If the size is 0 or 1, there is nothing to sort!
-    if (last - first <= 1)
-        return;
-    
-      // Recursively call sortSegments on partitioned sections of adjacentSegs vector
-    int pivotIndex = partition(adjacentSegs, first, last, end);
-    sortSegments(adjacentSegs, first, pivotIndex - 1, end);
-    sortSegments(adjacentSegs, pivotIndex + 1, last, end);
+      // The A* heuristic: straight-line miles to the end at the cheapest cost per mile, tightened by the
+      // overlay's landmarks if they cover this snapshot. Both bounds are consistent, and so is their max; landmarks
+      // that know only some of the nodes or edges would not be.
+    if (weights == nullptr)
+        return RouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, Stats>::find(
+            map, DistanceWeight(), CrowHeuristic(*map, end, 1), start, end, path, stats);
+    OverlayWeight overlay{weights};
+    if (weights->landmarksCover(*map))
+        return RouteSearch<OverlayWeight, LandmarkHeuristic, DenseLabels, Stats>::find(
+            map, overlay, LandmarkHeuristic(*map, end, *weights), start, end, path, stats);
+    return RouteSearch<OverlayWeight, CrowHeuristic, DenseLabels, Stats>::find(
+        map, overlay, CrowHeuristic(*map, end, weights->minCostPerMile()), start, end, path, stats);
 }
 
-int PointToPointRouterImpl::partition(vector<StreetSegment>& adjacentSegs, int low, int high, const GeoCoord& end) const
+  // Edge-based A*: a search state is the directed segment the robot arrived on, so the cost of leaving an intersection
+  // can depend on which way it came in. States are generated on the fly from the snapshot's adjacency; the
+  // turn-expanded graph is never built.
+  // PRECONDITION: nodes start and end are on the map, and start != end
+template<typename Stats>
+bool PointToPointRouterImpl::findOptimalRouteWithTurns(
+        const StreetMapSnapshot& map,
+        const EdgeWeights* weights,
+        const TurnCosts& turnCosts,
+        int start,
+        int end,
+        RoutePath& path,
+        Stats& stats) const
 {
-    int pi = low;
-    GeoCoord pivot = adjacentSegs[low].end;
-    do
+    TRACE_SCOPE("PointToPointRouter::findOptimalRouteWithTurns");
+    const double INF = numeric_limits<double>::infinity();
+    int stateCount = map.edgeIdLimit();
+    vector<double> cost(stateCount, INF);               // Cheapest known cost of arriving along each segment
+    vector<const GraphEdge*> segment(stateCount, nullptr);  // The segment behind each reached state
+    vector<int> fromNode(stateCount, -1);               // The node each reached segment leaves from
+    vector<int> parent(stateCount, -1);                 // The state (segment) each state was reached from
+    vector<bool> settled(stateCount, false);
+    vector<double> estimate(map.nodeCount(), -1);       // Per node, as in findOptimalRoute
+
+    const GeoCoord& goal = map.coord(end);
+    double costPerMile = (weights == nullptr) ? 1 : weights->minCostPerMile();
+    bool landmarks = weights != nullptr && weights->landmarksCover(map);
+    auto heuristic = [&](int node) {
+        if (estimate[node] < 0)
+        {
+            estimate[node] = distanceEarthMiles(map.coord(node), goal) * costPerMile;
+            if (landmarks)
+                estimate[node] = max(estimate[node], weights->landmarkBound(node, end));
+        }
+        return estimate[node];
+    };
+    auto bearingOf = [&](int from, const GraphEdge& e) {
+        const GeoCoord& a = map.coord(from);
+        const GeoCoord& b = map.coord(e.to);
+        return TurnCosts::bearing(a.latitude, a.longitude, b.latitude, b.longitude);
+    };
+
+    RadixHeapQueue toDo;    // (cost + heuristic, state); turn costs are never negative, so keys come out in order
+
+      // Leaving the start costs no turn, whichever way the robot sets off
+    for (const GraphEdge& e : map.edges(start))
     {
-        while ( low <= high && distanceEarthMiles(adjacentSegs[low].end, end) <= distanceEarthMiles(pivot, end) )
-            low++;
-        while ( distanceEarthMiles(adjacentSegs[high].end, end) > distanceEarthMiles(pivot, end) )
-            high--;
-        if (low < high)
+        stats.edgeRelaxed();
+        if (e.closed)
+            continue;
+        double c = edgeCost(weights, e);
+        if (c < cost[e.id])
         {
-            swapSegInVector(adjacentSegs, low, high);
+            cost[e.id] = c;
+            segment[e.id] = &e;
+            fromNode[e.id] = start;
+            toDo.push(c + heuristic(e.to), e.id);
+            stats.pushed(toDo.size());
         }
-        
     }
-    while (low < high);
-    
-    swapSegInVector(adjacentSegs, pi, high);
-    pi = high;
-    return pi;
-}
 
-void PointToPointRouterImpl::swapSegInVector(vector<StreetSegment>& adjacentSegs, int index1, int index2) const
-{
-      // Swaps two segments in a vector
-    const StreetSegment temp = adjacentSegs[index1];
-    adjacentSegs[index1] = adjacentSegs[index2];
-    adjacentSegs[index2] = temp;
+    while ( ! toDo.empty() )
+    {
+        int curr = toDo.pop();
+        stats.popped();
+        stats.visitedLookup();
+        if (settled[curr])
+            continue;
+        settled[curr] = true;
+        const GraphEdge& in = *segment[curr];
+
+          // If this segment arrives at the end, return true
+        if (in.to == end)
+        {
+            stats.endSearch();
+              // Follow the parent states back to the start, BACKWARDS, filling the hops from the last one
+            size_t hops = 0;
+            for (int s = curr; s >= 0; s = parent[s])
+                hops++;
+            path.m_hops.resize(hops);
+            path.m_miles = 0;
+            for (int s = curr; s >= 0; s = parent[s])
+            {
+                path.m_hops[--hops] = RoutePath::Hop{ fromNode[s], segment[s]->to, segment[s]->name, segment[s]->length };
+                path.m_miles += segment[s]->length;
+            }
+            stats.endReconstruct();
+            return true;
+        }
+
+          // Move onto every open segment leaving the intersection, paying for the turn
+        stats.nodeExpanded();
+        double inBearing = bearingOf(fromNode[curr], in);
+        for (const GraphEdge& out : map.edges(in.to))
+        {
+            stats.edgeRelaxed();
+            if (out.closed)
+                continue;
+            double angle = TurnCosts::angleBetween(inBearing, bearingOf(in.to, out));
+            double newCost = cost[curr] + turnCosts.cost(angle, out.name != in.name) + edgeCost(weights, out);
+            if (newCost < cost[out.id])
+            {
+                cost[out.id] = newCost;
+                segment[out.id] = &out;
+                fromNode[out.id] = in.to;
+                parent[out.id] = curr;
+                toDo.push(newCost + heuristic(out.to), out.id);
+                stats.pushed(toDo.size());
+            }
+        }
+    }
+
+    stats.endSearch();
+    return false;       // No route found
 }
 
 //******************** PointToPointRouter functions ***************************
@@ -268,5 +593,50 @@ DeliveryResult PointToPointRouter::generatePointToPointRoute(
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const
 {
-    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
+    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled, nullptr);
+}
+
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteStats* stats) const
+{
+    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled, stats);
+}
+
+DeliveryResult PointToPointRouter::generatePointToPointPath(const GeoCoord& start, const GeoCoord& end, RoutePath& path, RouteStats* stats) const
+{
+    return m_impl->generatePointToPointPath(start, end, path, stats);
+}
+
+void PointToPointRouter::setEdgeWeights(shared_ptr<const EdgeWeights> weights)
+{
+    m_impl->setEdgeWeights(weights);
+}
+
+bool PointToPointRouter::edgeWeightsUsable() const
+{
+    return m_impl->edgeWeightsUsable();
+}
+
+DeliveryResult PointToPointRouter::generateDistanceMatrix(const vector<GeoCoord>& points, vector<double>& matrix) const
+{
+    return m_impl->generateDistanceMatrix(points, matrix);
+}
+
+Task<RouteResult> PointToPointRouter::generatePointToPointRouteAsync(GeoCoord start, GeoCoord end) const
+{
+    return m_impl->generatePointToPointRouteAsync(start, end);
+}
+
+void PointToPointRouter::setTurnCosts(shared_ptr<const TurnCosts> turnCosts)
+{
+    m_impl->setTurnCosts(turnCosts);
+}
+
+void PointToPointRouter::setRouteCache(shared_ptr<const RouteCache> cache)
+{
+    m_impl->setRouteCache(cache);
 }
@@ -0,0 +1,163 @@
+// Polyline.cpp
+// Route vertices, Douglas-Peucker simplification and the encoded polyline format; see Polyline.h.
+
+#include "Polyline.h"
+#include "RoutePath.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+using namespace std;
+
+namespace
+{
+    const double MILES_PER_DEGREE = deg2rad(1) * 6371.0 / 1.609344;    // Along a meridian, on distanceEarthMiles' Earth
+
+      // Distance in miles from p to the segment a-b, on a flat projection around them (fine at street scale)
+    double milesFromSegment(const GeoCoord& p, const GeoCoord& a, const GeoCoord& b)
+    {
+        double xScale = MILES_PER_DEGREE * cos(deg2rad((a.latitude + b.latitude) / 2));
+        double px = (p.longitude - a.longitude) * xScale, py = (p.latitude - a.latitude) * MILES_PER_DEGREE;
+        double bx = (b.longitude - a.longitude) * xScale, by = (b.latitude - a.latitude) * MILES_PER_DEGREE;
+        double lengthSquared = bx * bx + by * by;
+        double t = lengthSquared > 0 ? (px * bx + py * by) / lengthSquared : 0;
+        t = t < 0 ? 0 : t > 1 ? 1 : t;
+        return hypot(px - t * bx, py - t * by);
+    }
+
+    void putValue(int64_t value, string& out)
+    {
+        uint64_t bits = value < 0 ? ~((uint64_t) value << 1) : (uint64_t) value << 1;     // Zigzag: the sign in bit 0
+        while (bits >= 0x20)
+        {
+            out.push_back((char) ((0x20 | (bits & 0x1f)) + 63));
+            bits >>= 5;
+        }
+        out.push_back((char) (bits + 63));
+    }
+
+      // Returns false if [pos, end) ends before the value does, or holds a character outside the format
+    bool getValue(const char*& pos, const char* end, int64_t& value)
+    {
+        uint64_t bits = 0;
+        for (int shift = 0; shift < 64; shift += 5)
+        {
+            if (pos == end || *pos < 63 || *pos > 126)
+                return false;
+            uint64_t chunk = (uint64_t) (*pos++ - 63);
+            bits |= (chunk & 0x1f) << shift;
+            if ((chunk & 0x20) == 0)
+            {
+                value = (bits & 1) ? (int64_t) ~(bits >> 1) : (int64_t) (bits >> 1);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+void routeVertices(const list<StreetSegment>& route, vector<GeoCoord>& points)
+{
+    points.clear();
+    if (route.empty())
+        return;
+    points.reserve(route.size() + 1);
+    points.push_back(route.front().start);
+    for (const StreetSegment& seg : route)
+        points.push_back(seg.end);
+}
+
+void routeVertices(const RoutePath& path, vector<GeoCoord>& points)
+{
+    points.clear();
+    if (path.empty())
+        return;
+    points.reserve(path.size() + 1);
+    points.push_back(path.start(0));
+    for (size_t i = 0; i < path.size(); i++)
+        points.push_back(path.end(i));
+}
+
+void simplifyPolyline(const vector<GeoCoord>& points, double toleranceMiles, vector<GeoCoord>& kept)
+{
+    if (points.size() < 3)
+    {
+        if (&kept != &points)
+            kept = points;
+        return;
+    }
+
+      // Keep the vertex farthest from the line between the ends of each span if it is beyond the tolerance, and split
+      // the span there; a stack of spans instead of recursion, so a long, winding leg cannot overflow the call stack
+    vector<bool> keep(points.size(), false);
+    keep.front() = keep.back() = true;
+    vector<pair<size_t, size_t>> spans;
+    spans.emplace_back(0, points.size() - 1);
+    while (!spans.empty())
+    {
+        pair<size_t, size_t> span = spans.back();
+        spans.pop_back();
+        double farthest = -1;
+        size_t split = span.first;
+        for (size_t i = span.first + 1; i < span.second; i++)
+        {
+            double miles = milesFromSegment(points[i], points[span.first], points[span.second]);
+            if (miles > farthest)
+            {
+                farthest = miles;
+                split = i;
+            }
+        }
+        if (farthest > toleranceMiles)
+        {
+            keep[split] = true;
+            spans.emplace_back(span.first, split);
+            spans.emplace_back(split, span.second);
+        }
+    }
+
+    vector<GeoCoord> result;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (keep[i])
+            result.push_back(points[i]);
+    }
+    kept = move(result);
+}
+
+void appendPolyline(const vector<GeoCoord>& points, string& out, int precision)
+{
+    double scale = pow(10.0, precision);
+    int64_t lastLat = 0, lastLon = 0;
+    for (const GeoCoord& gc : points)
+    {
+        int64_t lat = llround(gc.latitude * scale);
+        int64_t lon = llround(gc.longitude * scale);
+        putValue(lat - lastLat, out);
+        putValue(lon - lastLon, out);
+        lastLat = lat;
+        lastLon = lon;
+    }
+}
+
+bool decodePolyline(const string& encoded, vector<GeoCoord>& points, int precision)
+{
+    points.clear();
+    double scale = pow(10.0, precision);
+    const char* pos = encoded.data();
+    const char* end = pos + encoded.size();
+    int64_t lat = 0, lon = 0;
+    char latText[32], lonText[32];
+    while (pos != end)
+    {
+        int64_t latDelta, lonDelta;
+        if (!getValue(pos, end, latDelta) || !getValue(pos, end, lonDelta))
+            return false;
+        lat += latDelta;
+        lon += lonDelta;
+        snprintf(latText, sizeof(latText), "%.*f", precision, lat / scale);
+        snprintf(lonText, sizeof(lonText), "%.*f", precision, lon / scale);
+        points.push_back(GeoCoord(latText, lonText));
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+// Polyline.h
+// Route geometry in the encoded polyline format (the one most web maps read), for storing and shipping routes at a
+// fraction of the size of their StreetSegments' text coordinates.
+//
+//   vector<GeoCoord> points;
+//   routeVertices(plan.legs[0], points);           // The leg's intersections, in order
+//   simplifyPolyline(points, 0.005, points);       // Optional: drop vertices within 0.005 miles of the line kept
+//   string encoded;
+//   appendPolyline(points, encoded);                // e.g. "}b~nEfokqU..."
+//
+// Each point is the difference from the one before, in units of 10^-precision degrees (5 by default, about 1.1 m),
+// latitude then longitude, zigzag-signed and written 5 bits per printable character (ASCII 63-126). Successive
+// vertices of a street route are close together, so most points take 2-4 characters per coordinate instead of the
+// 10-12 digits of each text coordinate.
+//
+// Simplification is Douglas-Peucker: a vertex is dropped when it lies within toleranceMiles of the line between the
+// vertices kept on either side of it. The first and last vertex (the stops) are always kept.
+
+#ifndef POLYLINE_INCLUDED
+#define POLYLINE_INCLUDED
+
+#include "provided.h"
+#include <list>
+#include <string>
+#include <vector>
+
+class RoutePath;
+
+  // Replaces points with the vertices a route passes through: the first segment's start, then every segment's end
+void routeVertices(const std::list<StreetSegment>& route, std::vector<GeoCoord>& points);
+void routeVertices(const RoutePath& path, std::vector<GeoCoord>& points);
+
+  // Replaces kept with the vertices of points that Douglas-Peucker keeps at toleranceMiles (kept may be points)
+void simplifyPolyline(const std::vector<GeoCoord>& points, double toleranceMiles, std::vector<GeoCoord>& kept);
+
+  // Appends the encoding of points to out
+void appendPolyline(const std::vector<GeoCoord>& points, std::string& out, int precision = 5);
+
+  // Replaces points with the ones appendPolyline encoded in encoded; returns false (leaving points partly filled) if it is malformed.
+  // Coordinates are rounded to precision decimal places, and so is their text.
+bool decodePolyline(const std::string& encoded, std::vector<GeoCoord>& points, int precision = 5);
+
+#endif // POLYLINE_INCLUDED
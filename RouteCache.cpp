@@ -0,0 +1,268 @@
+// RouteCache.cpp
+// The memory-mapped route cache and its builder; see RouteCache.h for the file layout.
+
+#include "RouteCache.h"
+#include "StreetMapSnapshot.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <utility>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const char MAGIC[8] = { 'R', 'T', 'C', 'A', 'C', 'H', 'E', '1' };
+}
+
+RouteCache::RouteCache()
+ : m_mapping(nullptr), m_mappingSize(0), m_fingerprint(0), m_entries(nullptr), m_entryCount(0), m_paths(nullptr), m_pathNodeCount(0)
+{
+}
+
+RouteCache::~RouteCache()
+{
+#ifndef _WIN32
+    if (m_mapping != nullptr)
+        munmap(m_mapping, m_mappingSize);
+#endif
+}
+
+shared_ptr<const RouteCache> RouteCache::open(const string& path)
+{
+    TRACE_SCOPE("RouteCache::open");
+    shared_ptr<RouteCache> cache(new RouteCache());
+    const char* data = nullptr;
+    size_t size = 0;
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            cache->m_mapping = mapping;
+            cache->m_mappingSize = (size_t) info.st_size;
+            madvise(mapping, cache->m_mappingSize, MADV_RANDOM);     // Lookups are binary searches
+            data = static_cast<const char*>(mapping);
+            size = cache->m_mappingSize;
+        }
+    }
+    close(fd);
+#else
+    ifstream inf(path, ios::binary);
+    if (!inf)
+        return nullptr;
+    cache->m_buffer.assign(istreambuf_iterator<char>(inf), istreambuf_iterator<char>());
+    data = cache->m_buffer.data();
+    size = cache->m_buffer.size();
+#endif
+
+      // Everything the lookups rely on is checked once here: the sections must exactly fill the file
+    FileHeader header;
+    if (data == nullptr || size < sizeof(header))
+        return nullptr;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        return nullptr;
+    size_t rest = size - sizeof(header);
+    if (header.entryCount > rest / sizeof(FileEntry))
+        return nullptr;
+    rest -= header.entryCount * sizeof(FileEntry);
+    if (rest != header.pathNodeCount * sizeof(uint32_t))
+        return nullptr;
+
+    cache->m_fingerprint = header.fingerprint;
+    cache->m_entries = reinterpret_cast<const FileEntry*>(data + sizeof(header));
+    cache->m_entryCount = header.entryCount;
+    cache->m_paths = reinterpret_cast<const uint32_t*>(cache->m_entries + header.entryCount);
+    cache->m_pathNodeCount = header.pathNodeCount;
+    return cache;
+}
+
+bool RouteCache::usableWith(const StreetMapSnapshot& map) const
+{
+    return map.fingerprint() == m_fingerprint && !map.updatedSinceLoad();
+}
+
+bool RouteCache::find(int from, int to, double& miles, const uint32_t*& path, size_t& pathLength) const
+{
+    if (from < 0 || to < 0)
+        return false;
+    uint64_t wanted = key(from, to);
+    const FileEntry* end = m_entries + m_entryCount;
+    const FileEntry* e = lower_bound(m_entries, end, wanted, [](const FileEntry& entry, uint64_t k) {
+        return entry.key < k;
+    });
+    if (e == end || e->key != wanted || e->pathOffset > m_pathNodeCount || e->pathLength > m_pathNodeCount - e->pathOffset)
+        return false;
+    miles = e->miles;
+    path = m_paths + e->pathOffset;
+    pathLength = e->pathLength;
+    return true;
+}
+
+//******************** RouteCacheBuilder ***************************
+
+RouteCacheBuilder::RouteCacheBuilder(const StreetMap* sm)
+ : m_streetMap(sm)
+{
+    shared_ptr<const StreetMapSnapshot> map = sm->snapshot();
+    m_fingerprint = map->fingerprint();
+}
+
+bool RouteCacheBuilder::sameMapAsLoaded(const StreetMapSnapshot& map) const
+{
+    return map.fingerprint() == m_fingerprint && !map.updatedSinceLoad();
+}
+
+DeliveryResult RouteCacheBuilder::add(const GeoCoord& start, const GeoCoord& end)
+{
+    PointToPointRouter router(m_streetMap);
+    list<StreetSegment> route;
+    double miles;
+    DeliveryResult result = router.generatePointToPointRoute(start, end, route, miles);
+    if (result != DELIVERY_SUCCESS || route.empty())
+        return result;
+
+      // Node ids only mean anything for the map as loaded; a route found after an update may use new segments
+    shared_ptr<const StreetMapSnapshot> map = m_streetMap->snapshot();
+    if (!sameMapAsLoaded(*map))
+        return NO_ROUTE;
+    Route cached;
+    cached.miles = miles;
+    cached.nodes.reserve(route.size() + 1);
+    cached.nodes.push_back((uint32_t) map->nodeId(route.front().start));
+    for (const StreetSegment& segment : route)
+        cached.nodes.push_back((uint32_t) map->nodeId(segment.end));
+
+    uint64_t k = RouteCache::key(cached.nodes.front(), cached.nodes.back());
+    lock_guard<mutex> lock(m_mutex);
+    m_routes[k] = move(cached);
+    return DELIVERY_SUCCESS;
+}
+
+size_t RouteCacheBuilder::merge(const RouteCache& cache)
+{
+    if (cache.m_fingerprint != m_fingerprint)
+        return 0;
+    size_t added = 0;
+    lock_guard<mutex> lock(m_mutex);
+    for (size_t i = 0; i < cache.m_entryCount; i++)
+    {
+        const RouteCache::FileEntry& e = cache.m_entries[i];
+        if (e.pathOffset > cache.m_pathNodeCount || e.pathLength > cache.m_pathNodeCount - e.pathOffset)
+            continue;
+        const uint32_t* path = cache.m_paths + e.pathOffset;
+        if (m_routes.emplace(e.key, Route{e.miles, vector<uint32_t>(path, path + e.pathLength)}).second)
+            added++;
+    }
+    return added;
+}
+
+size_t RouteCacheBuilder::warmUpDepotLegs(const GeoCoord& depot, const vector<DeliveryRequest>& history, size_t maxStops)
+{
+    TRACE_SCOPE("RouteCacheBuilder::warmUpDepotLegs");
+
+      // Count how often each stop was delivered to; the most frequent come first (ties in order of first appearance)
+    map<GeoCoord, size_t> firstSeen;
+    vector<pair<size_t, GeoCoord>> stops;      // (deliveries, stop)
+    for (const DeliveryRequest& request : history)
+    {
+        auto it = firstSeen.emplace(request.location, stops.size()).first;
+        if (it->second == stops.size())
+            stops.push_back(make_pair(0, request.location));
+        stops[it->second].first++;
+    }
+    stable_sort(stops.begin(), stops.end(), [](const pair<size_t, GeoCoord>& a, const pair<size_t, GeoCoord>& b) {
+        return a.first > b.first;
+    });
+    stops.resize(min(stops.size(), maxStops));
+
+    size_t before = size();
+    ThreadPool::shared().parallelFor(stops.size(), [&](size_t i) {
+        add(depot, stops[i].second);
+        add(stops[i].second, depot);
+    });
+    return size() - before;
+}
+
+size_t RouteCacheBuilder::size() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_routes.size();
+}
+
+bool RouteCacheBuilder::write(const string& path) const
+{
+    TRACE_SCOPE("RouteCacheBuilder::write");
+    if (!sameMapAsLoaded(*m_streetMap->snapshot()))
+        return false;
+    lock_guard<mutex> lock(m_mutex);
+
+    RouteCache::FileHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.fingerprint = m_fingerprint;
+    header.entryCount = m_routes.size();
+    header.pathNodeCount = 0;
+    vector<RouteCache::FileEntry> entries;
+    entries.reserve(m_routes.size());
+    for (const auto& keyAndRoute : m_routes)
+    {
+        RouteCache::FileEntry e;
+        e.key = keyAndRoute.first;
+        e.miles = keyAndRoute.second.miles;
+        e.pathOffset = header.pathNodeCount;
+        e.pathLength = (uint32_t) keyAndRoute.second.nodes.size();
+        e.reserved = 0;
+        entries.push_back(e);
+        header.pathNodeCount += e.pathLength;
+    }
+
+#ifndef _WIN32
+    string temporary = path + ".tmp." + to_string(getpid());
+#else
+    string temporary = path + ".tmp";
+#endif
+    {
+        ofstream outf(temporary, ios::binary | ios::trunc);
+        if (!outf)
+            return false;
+        outf.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outf.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(RouteCache::FileEntry));
+        for (const auto& keyAndRoute : m_routes)
+        {
+            const vector<uint32_t>& nodes = keyAndRoute.second.nodes;
+            outf.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(uint32_t));
+        }
+        if (!outf.flush())
+        {
+            outf.close();
+            remove(temporary.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    remove(path.c_str());       // rename does not replace an existing file here
+#endif
+    if (rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
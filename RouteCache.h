@@ -0,0 +1,120 @@
+// RouteCache.h
+// A persistent cache of shortest routes (by distance) between pairs of map nodes, kept in a file that any number of
+// processes can memory-map read-only and share through the page cache.
+//
+//   RouteCacheBuilder builder(&streetMap);
+//   builder.warmUpDepotLegs(depot, pastDeliveries, 200);     // The legs to and from the most frequent stops
+//   builder.write("routes.cache");
+//   ...
+//   router.setRouteCache(RouteCache::open("routes.cache"));  // In every process that routes on this map
+//
+// A cache file is stamped with the loaded map's fingerprint (see StreetMapSnapshot.h). Routers only answer from it
+// when routing by distance (no EdgeWeights or TurnCosts) on a snapshot with that fingerprint that has not been
+// updated since it was loaded, so a stale file or a live closure can never produce a wrong route; anything the
+// cache cannot answer is searched for as usual.
+//
+// File layout (host byte order; files are not portable between machines of different endianness):
+//   FileHeader, then entryCount FileEntry records sorted by key = (from << 32) | to, then pathNodeCount uint32_t
+//   node ids. Entry e's route visits nodes paths[e.pathOffset, e.pathOffset + e.pathLength), from first, to last.
+
+#ifndef ROUTECACHE_INCLUDED
+#define ROUTECACHE_INCLUDED
+
+#include "provided.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class StreetMapSnapshot;
+
+class RouteCache
+{
+  public:
+      // Maps the file read-only; nullptr if it is missing, truncated or not a route cache
+    static std::shared_ptr<const RouteCache> open(const std::string& path);
+    ~RouteCache();
+
+      // True if this cache was built for map's data and map has not been updated since it was loaded
+    bool usableWith(const StreetMapSnapshot& map) const;
+    std::size_t size() const { return m_entryCount; }
+
+      // The cached route from node from to node to: its miles and the node ids along it (from first, to last).
+      // path points into the mapping and stays valid as long as this cache does.
+    bool find(int from, int to, double& miles, const uint32_t*& path, std::size_t& pathLength) const;
+
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+
+  private:
+    friend class RouteCacheBuilder;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint64_t fingerprint;
+        uint64_t entryCount;
+        uint64_t pathNodeCount;
+    };
+    struct FileEntry
+    {
+        uint64_t key;
+        double miles;
+        uint64_t pathOffset;
+        uint32_t pathLength;
+        uint32_t reserved;
+    };
+
+    RouteCache();
+    static uint64_t key(uint32_t from, uint32_t to) { return (uint64_t(from) << 32) | to; }
+
+    void* m_mapping;
+    std::size_t m_mappingSize;
+    std::vector<char> m_buffer;     // The file's contents where it cannot be mapped
+    uint64_t m_fingerprint;
+    const FileEntry* m_entries;
+    std::size_t m_entryCount;
+    const uint32_t* m_paths;
+    std::size_t m_pathNodeCount;
+};
+
+  // Collects routes on a loaded StreetMap and writes them as a RouteCache file. Routes are found with a plain
+  // PointToPointRouter; once the map is updated, add() refuses new routes and write() fails.
+class RouteCacheBuilder
+{
+  public:
+    explicit RouteCacheBuilder(const StreetMap* sm);
+
+      // Routes start -> end and keeps the route. Safe to call from several threads at once.
+    DeliveryResult add(const GeoCoord& start, const GeoCoord& end);
+      // Keeps every route in cache (if it was built for this map, e.g. to extend an existing file); returns how
+      // many were new
+    std::size_t merge(const RouteCache& cache);
+      // Warm-up mode: routes the depot -> stop and stop -> depot legs for the maxStops stops that appear most often
+      // in history, in parallel on the shared thread pool. Returns how many routes were added.
+    std::size_t warmUpDepotLegs(const GeoCoord& depot, const std::vector<DeliveryRequest>& history, std::size_t maxStops);
+    std::size_t size() const;
+
+      // Writes the cache to a temporary file and renames it over path, so processes that already have the old file
+      // mapped keep a consistent copy
+    bool write(const std::string& path) const;
+
+  private:
+    struct Route
+    {
+        double miles;
+        std::vector<uint32_t> nodes;
+    };
+
+    const StreetMap* m_streetMap;
+    uint64_t m_fingerprint;
+    std::map<uint64_t, Route> m_routes;     // By RouteCache::key, the order the file wants
+    mutable std::mutex m_mutex;
+
+    bool sameMapAsLoaded(const StreetMapSnapshot& map) const;
+};
+
+#endif // ROUTECACHE_INCLUDED
@@ -0,0 +1,73 @@
+// RoutePath.h
+// A route as PointToPointRouter::generatePointToPointPath returns it: one contiguous array of hops, each the map edge
+// the search arrived by, so segment i's endpoints, street name, length and bearing are all O(1) lookups by index.
+//
+// The search remembers the edge it reached each node along, so the path is rebuilt in a single pass over those
+// parent edges, straight into place, with no adjacency lookups. A path keeps the snapshot it was found on alive
+// (see StreetMapSnapshot.h), so its names and coordinates stay valid whatever happens to the map afterwards.
+
+#ifndef ROUTEPATH_INCLUDED
+#define ROUTEPATH_INCLUDED
+
+#include "provided.h"
+#include "StreetMapSnapshot.h"
+#include <cmath>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+class RoutePath
+{
+  public:
+    std::size_t size() const { return m_hops.size(); }
+    bool empty() const { return m_hops.empty(); }
+    double miles() const { return m_miles; }
+
+    const GeoCoord& start(std::size_t i) const { return m_map->coord(m_hops[i].from); }
+    const GeoCoord& end(std::size_t i) const { return m_map->coord(m_hops[i].to); }
+    const std::string& streetName(std::size_t i) const { return m_map->streetName(m_hops[i].name); }
+    double length(std::size_t i) const { return m_hops[i].length; }
+      // Direction of segment i in degrees counterclockwise from east, as angleOfLine measures it
+    double bearing(std::size_t i) const
+    {
+        const GeoCoord& a = start(i);
+        const GeoCoord& b = end(i);
+        double result = rad2deg(atan2(b.latitude - a.latitude, b.longitude - a.longitude));
+        return result < 0 ? result + 360 : result;
+    }
+    StreetSegment segment(std::size_t i) const { return StreetSegment(start(i), end(i), streetName(i)); }
+
+      // Appends the path to route as StreetSegments, the form generatePointToPointRoute returns
+    void appendTo(std::list<StreetSegment>& route) const
+    {
+        for (std::size_t i = 0; i < m_hops.size(); i++)
+            route.push_back(segment(i));
+    }
+
+    void clear()
+    {
+        m_map.reset();
+        m_hops.clear();
+        m_miles = 0;
+    }
+
+  private:
+    friend class PointToPointRouterImpl;
+    template<typename Weight, typename Heuristic, typename Labels, typename Stats, typename Queue> friend class RouteSearch;
+
+    struct Hop
+    {
+        int from;
+        int to;
+        int name;
+        double length;
+    };
+
+    std::shared_ptr<const StreetMapSnapshot> m_map;
+    std::vector<Hop> m_hops;
+    double m_miles = 0;
+};
+
+#endif // ROUTEPATH_INCLUDED
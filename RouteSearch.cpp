@@ -0,0 +1,128 @@
+// RouteSearch.cpp
+// The policy-based point-to-point search and its explicit instantiations; see RouteSearch.h.
+
+#include "RouteSearch.h"
+#include "RoutePath.h"
+#include "RouteStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+template<typename Weight, typename Heuristic, typename Labels, typename Stats, typename Queue>
+bool RouteSearch<Weight, Heuristic, Labels, Stats, Queue>::find(
+        const shared_ptr<const StreetMapSnapshot>& map,
+        const Weight& weight,
+        const Heuristic& heuristic,
+        int start,
+        int end,
+        RoutePath& path,
+        Stats& stats)
+{
+    TRACE_SCOPE("PointToPointRouter::findOptimalRoute");
+    Labels labels(map->nodeCount());
+    auto estimate = [&](NodeLabel& label, int node) {
+        if constexpr (Heuristic::CACHED)
+        {
+            if (label.estimate < 0)
+                label.estimate = heuristic(node);
+            return label.estimate;
+        }
+        else
+            return heuristic(node);
+    };
+
+      // Open list of (cost + heuristic, node); a node may appear more than once, stale copies are skipped
+    Queue toDo;
+
+      // Process starting node start
+    NodeLabel& first = labels[start];
+    first.cost = 0;
+    toDo.push(estimate(first, start), start);
+    stats.pushed(toDo.size());
+
+    while ( ! toDo.empty() )
+    {
+        int curr = toDo.pop();
+        stats.popped();
+        stats.visitedLookup();
+        NodeLabel& label = labels[curr];
+        if (label.settled)
+            continue;
+        label.settled = true;
+
+          // If we have reached the end, return true
+        if (curr == end)
+        {
+            stats.endSearch();
+            recreateRouteHistory(labels, start, end, path);
+            path.m_map = map;
+            stats.endReconstruct();
+            return true;
+        }
+
+          // Relax every open StreetSegment leaving curr
+        stats.nodeExpanded();
+        double currCost = label.cost;
+        for (const GraphEdge& e : map->edges(curr))
+        {
+            stats.edgeRelaxed();
+            if (e.closed)
+                continue;
+            double newCost = currCost + weight.cost(e);
+            NodeLabel& next = labels[e.to];
+            if (newCost < next.cost)
+            {
+                next.cost = newCost;
+                next.parent = curr;
+                next.parentEdge = &e;
+                toDo.push(newCost + estimate(next, e.to), e.to);
+                stats.pushed(toDo.size());
+            }
+        }
+    }
+
+    stats.endSearch();
+    return false;       // No route found
+}
+
+template<typename Weight, typename Heuristic, typename Labels, typename Stats, typename Queue>
+void RouteSearch<Weight, Heuristic, Labels, Stats, Queue>::recreateRouteHistory(Labels& labels, int start, int end, RoutePath& path)
+{
+    TRACE_SCOPE("PointToPointRouter::recreateRouteHistory");
+      // Count the hops, then trace the parent edges from end back to start, BACKWARDS, filling the path from its end
+    size_t hops = 0;
+    for (int node = end; node != start; node = labels[node].parent)
+        hops++;
+    path.m_hops.resize(hops);
+    path.m_miles = 0;
+
+      // While we have not reached the start... (we are retracing steps backwards)
+    for (int endingNode = end; endingNode != start; )
+    {
+        const NodeLabel& label = labels[endingNode];
+        path.m_hops[--hops] = RoutePath::Hop{ label.parent, endingNode, label.parentEdge->name, label.parentEdge->length };
+        path.m_miles += label.parentEdge->length;      // Add to the distance travelled for the route
+        endingNode = label.parent;
+    }
+}
+
+  // What PointToPointRouter routes with: A* by distance, by an overlay's costs, or by a customized overlay's costs
+  // with landmark bounds, each with and without statistics
+template class RouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, NoRouteStats>;
+template class RouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, CollectRouteStats>;
+template class RouteSearch<OverlayWeight, CrowHeuristic, DenseLabels, NoRouteStats>;
+template class RouteSearch<OverlayWeight, CrowHeuristic, DenseLabels, CollectRouteStats>;
+template class RouteSearch<OverlayWeight, LandmarkHeuristic, DenseLabels, NoRouteStats>;
+template class RouteSearch<OverlayWeight, LandmarkHeuristic, DenseLabels, CollectRouteStats>;
+
+  // For comparison (see the benchmarks): sparse labels, plain Dijkstra, fewest segments, and the other open lists
+template class RouteSearch<DistanceWeight, CrowHeuristic, SparseLabels, NoRouteStats>;
+template class RouteSearch<DistanceWeight, CrowHeuristic, SparseLabels, CollectRouteStats>;
+template class RouteSearch<DistanceWeight, NoHeuristic, DenseLabels, NoRouteStats>;
+template class RouteSearch<DistanceWeight, NoHeuristic, DenseLabels, CollectRouteStats>;
+template class RouteSearch<HopWeight, NoHeuristic, DenseLabels, NoRouteStats>;
+template class RouteSearch<HopWeight, NoHeuristic, DenseLabels, CollectRouteStats>;
+template class RouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, NoRouteStats, BinaryHeapQueue>;
+template class RouteSearch<DistanceWeight, CrowHeuristic, DenseLabels, NoRouteStats, QuaternaryHeapQueue>;
+template class RouteSearch<DistanceWeight, NoHeuristic, DenseLabels, NoRouteStats, BinaryHeapQueue>;
+template class RouteSearch<DistanceWeight, NoHeuristic, DenseLabels, NoRouteStats, QuaternaryHeapQueue>;
@@ -0,0 +1,147 @@
+// RouteSearch.h
+// PointToPointRouter's point-to-point search as a template over compile-time policies, so every mode gets its own
+// inlined inner loop instead of testing at each edge what it is supposed to be doing:
+//
+//   Weight     what a route minimizes: DistanceWeight (miles), OverlayWeight (an EdgeWeights overlay, e.g. travel
+//              time) or HopWeight (segments, which makes the search a breadth-first search in all but queue order)
+//   Heuristic  the A* lower bound on the cost still to go: NoHeuristic (Dijkstra), CrowHeuristic (straight-line
+//              miles at the cheapest cost per mile) or LandmarkHeuristic (that, tightened by a customized overlay)
+//   Labels     where per-node search state lives: DenseLabels (an array over every node) or SparseLabels (a hash
+//              table of the nodes reached, for short searches on large maps)
+//   Stats      NoRouteStats or CollectRouteStats (see RouteStats.h)
+//   Queue      the open list: BinaryHeapQueue, QuaternaryHeapQueue or RadixHeapQueue (see OpenList.h)
+//
+// The template is defined in RouteSearch.cpp and explicitly instantiated there for the configurations the router
+// uses (and a few for comparison); other combinations will not link until they are added to that list.
+
+#ifndef ROUTESEARCH_INCLUDED
+#define ROUTESEARCH_INCLUDED
+
+#include "provided.h"
+#include "EdgeWeights.h"
+#include "OpenList.h"
+#include "StreetMapSnapshot.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class RoutePath;
+
+//******************** Weight policies ***************************
+
+struct DistanceWeight
+{
+    double cost(const GraphEdge& e) const { return e.length; }
+    double minCostPerMile() const { return 1; }
+};
+
+struct OverlayWeight
+{
+    const EdgeWeights* weights;
+    double cost(const GraphEdge& e) const { return weights->cost(e); }
+    double minCostPerMile() const { return weights->minCostPerMile(); }
+};
+
+struct HopWeight
+{
+    double cost(const GraphEdge&) const { return 1; }
+    double minCostPerMile() const { return 0; }
+};
+
+//******************** Heuristic policies ***************************
+// Each is consistent, so a node's cost is final the first time it is taken off the open list. CACHED says whether
+// the search should remember a node's estimate instead of asking again.
+
+struct NoHeuristic
+{
+    static constexpr bool CACHED = false;
+    double operator()(int) const { return 0; }
+};
+
+struct CrowHeuristic
+{
+    static constexpr bool CACHED = true;
+    CrowHeuristic(const StreetMapSnapshot& map, int goal, double costPerMile)
+     : m_map(&map), m_goal(map.coord(goal)), m_costPerMile(costPerMile)
+    {}
+    double operator()(int node) const { return distanceEarthMiles(m_map->coord(node), m_goal) * m_costPerMile; }
+
+  private:
+    const StreetMapSnapshot* m_map;
+    GeoCoord m_goal;
+    double m_costPerMile;
+};
+
+struct LandmarkHeuristic
+{
+    static constexpr bool CACHED = true;
+    LandmarkHeuristic(const StreetMapSnapshot& map, int goal, const EdgeWeights& weights)
+     : m_crow(map, goal, weights.minCostPerMile()), m_weights(&weights), m_goal(goal)
+    {}
+    double operator()(int node) const { return std::max(m_crow(node), m_weights->landmarkBound(node, m_goal)); }
+
+  private:
+    CrowHeuristic m_crow;
+    const EdgeWeights* m_weights;
+    int m_goal;
+};
+
+//******************** Label policies ***************************
+
+  // What the search knows about one node
+struct NodeLabel
+{
+    double cost = std::numeric_limits<double>::infinity();     // Cheapest known cost from the start
+    double estimate = -1;                   // The heuristic's bound, once asked for (CACHED heuristics only)
+    const GraphEdge* parentEdge = nullptr;  // The edge the node was reached along on its cheapest route...
+    int parent = -1;                        // ... and the node that edge leaves from
+    bool settled = false;                   // Whether cost is final
+};
+
+class DenseLabels
+{
+  public:
+    explicit DenseLabels(int nodeCount) : m_labels(nodeCount) {}
+    NodeLabel& operator[](int node) { return m_labels[node]; }
+
+  private:
+    std::vector<NodeLabel> m_labels;
+};
+
+  // References stay valid as more nodes are labelled (unordered_map never moves its elements)
+class SparseLabels
+{
+  public:
+    explicit SparseLabels(int) { m_labels.reserve(1024); }
+    NodeLabel& operator[](int node) { return m_labels[node]; }
+
+  private:
+    std::unordered_map<int, NodeLabel> m_labels;
+};
+
+//******************** The search ***************************
+
+template<typename Weight, typename Heuristic, typename Labels, typename Stats, typename Queue = RadixHeapQueue>
+class RouteSearch
+{
+  public:
+      // A* search for the cheapest route from node start to node end. If there is one, fills path with its hops
+      // (on map) and returns true; otherwise leaves path alone.
+      // PRECONDITION: nodes start and end are on the map
+    static bool find(
+        const std::shared_ptr<const StreetMapSnapshot>& map,
+        const Weight& weight,
+        const Heuristic& heuristic,
+        int start,
+        int end,
+        RoutePath& path,
+        Stats& stats);
+
+  private:
+      // Rebuilds the route from the labels' parent edges in one pass, filling path's hops in place
+    static void recreateRouteHistory(Labels& labels, int start, int end, RoutePath& path);
+};
+
+#endif // ROUTESEARCH_INCLUDED
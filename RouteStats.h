@@ -0,0 +1,119 @@
+// RouteStats.h
+// Per-query search statistics for PointToPointRouter, and the compile-time policies the router's search is
+// instantiated with. NoRouteStats compiles every hook down to nothing; CollectRouteStats fills a RouteStats.
+
+#ifndef ROUTESTATS_INCLUDED
+#define ROUTESTATS_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+
+struct RouteStats
+{
+    long long queries = 0;          // Number of queries these stats cover (1 for a single query)
+    long long nodesExpanded = 0;    // GeoCoords taken off the open list and expanded
+    long long edgesRelaxed = 0;     // StreetSegments examined while expanding nodes
+    long long heapPushes = 0;       // Insertions into the open list
+    long long heapPops = 0;         // Removals from the open list
+    long long hashLookups = 0;      // Hash map probes (adjacency lookups and parent-map writes/reads)
+    long long visitedLookups = 0;   // Membership tests against the visited set
+    long long peakFrontier = 0;     // Largest open list size seen (the max over all queries when aggregated)
+    long long weightsIgnored = 0;   // Queries that routed by distance because the router's EdgeWeights were built on
+                                    // other map data (see EdgeWeights::usableWith)
+
+      // Wall time per phase, in seconds
+    double validateSeconds = 0;     // Checking that both endpoints are on the map
+    double searchSeconds = 0;       // The graph search itself
+    double reconstructSeconds = 0;  // Rebuilding the route from the search's parent links
+
+    double totalSeconds() const { return validateSeconds + searchSeconds + reconstructSeconds; }
+
+      // Aggregates another query's (or another aggregate's) statistics into this one
+    RouteStats& operator+=(const RouteStats& other)
+    {
+        queries += other.queries;
+        nodesExpanded += other.nodesExpanded;
+        edgesRelaxed += other.edgesRelaxed;
+        heapPushes += other.heapPushes;
+        heapPops += other.heapPops;
+        hashLookups += other.hashLookups;
+        visitedLookups += other.visitedLookups;
+        if (other.peakFrontier > peakFrontier)
+            peakFrontier = other.peakFrontier;
+        weightsIgnored += other.weightsIgnored;
+        validateSeconds += other.validateSeconds;
+        searchSeconds += other.searchSeconds;
+        reconstructSeconds += other.reconstructSeconds;
+        return *this;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const RouteStats& s)
+{
+    os << s.queries << " queries, " << s.nodesExpanded << " nodes expanded, " << s.edgesRelaxed << " edges relaxed, "
+       << s.heapPushes << " pushes, " << s.heapPops << " pops, " << s.hashLookups << " hash lookups, "
+       << s.visitedLookups << " visited lookups, peak frontier " << s.peakFrontier << ", ";
+    if (s.weightsIgnored > 0)
+        os << s.weightsIgnored << " ignoring stale weights, ";
+    os << s.validateSeconds * 1e3 << "/" << s.searchSeconds * 1e3 << "/" << s.reconstructSeconds * 1e3
+       << " ms validate/search/reconstruct";
+    return os;
+}
+
+  // Stats policy that records nothing; every call inlines away
+struct NoRouteStats
+{
+    void nodeExpanded() {}
+    void edgeRelaxed() {}
+    void pushed(std::size_t) {}
+    void popped() {}
+    void hashLookup() {}
+    void visitedLookup() {}
+    void ignoredWeights() {}
+    void startPhase() {}
+    void endValidate() {}
+    void endSearch() {}
+    void endReconstruct() {}
+};
+
+  // Stats policy that counts into a caller-provided RouteStats
+class CollectRouteStats
+{
+  public:
+    explicit CollectRouteStats(RouteStats& stats) : m_stats(stats) {}
+
+    void nodeExpanded() { m_stats.nodesExpanded++; }
+    void edgeRelaxed() { m_stats.edgesRelaxed++; }
+    void pushed(std::size_t frontierSize)
+    {
+        m_stats.heapPushes++;
+        if ((long long) frontierSize > m_stats.peakFrontier)
+            m_stats.peakFrontier = (long long) frontierSize;
+    }
+    void popped() { m_stats.heapPops++; }
+    void hashLookup() { m_stats.hashLookups++; }
+    void visitedLookup() { m_stats.visitedLookups++; }
+    void ignoredWeights() { m_stats.weightsIgnored = 1; }     // Once per query, however many tile areas it tries
+
+    void startPhase() { m_phaseStart = Clock::now(); }
+    void endValidate() { m_stats.validateSeconds += elapsed(); }
+    void endSearch() { m_stats.searchSeconds += elapsed(); }
+    void endReconstruct() { m_stats.reconstructSeconds += elapsed(); }
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+    RouteStats& m_stats;
+    Clock::time_point m_phaseStart;
+
+      // Seconds since startPhase, restarting the clock for the next phase
+    double elapsed()
+    {
+        Clock::time_point now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - m_phaseStart).count();
+        m_phaseStart = now;
+        return seconds;
+    }
+};
+
+#endif // ROUTESTATS_INCLUDED
@@ -1,12 +1,26 @@
 #include "provided.h"
 #include "ExpandableHashMap.h"
+#include "Isochrone.h"
+#include "MapTiles.h"
+#include "StreetMapSnapshot.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 #include <string>
 #include <vector>
 #include <functional>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
 using namespace std;
 
 unsigned int hasher(const GeoCoord& g)
@@ -14,41 +28,459 @@ unsigned int hasher(const GeoCoord& g)
     return std::hash<string>()(g.latitudeText + g.longitudeText);
 }
 
+unsigned int hasher(const string& s)
+{
+    return std::hash<string>()(s);
+}
+
+namespace
+{
+  // A line of map data as parsed: a street name, or a segment of the most recent street
+struct ParsedLine
+{
+    bool isName;
+    string name;        // If isName
+    GeoCoord start;     // Otherwise
+    GeoCoord end;
+    double length;
+};
+
+  // A segment to build a base graph from, its coordinates held elsewhere (by parsed lines or resident tiles)
+struct MapSegment
+{
+    int name;
+    const GeoCoord* start;
+    const GeoCoord* end;
+    double length;
+};
+
+  // Miles per degree of latitude, on distanceEarthMiles' Earth
+const double MILES_PER_DEGREE = deg2rad(1) * 6371.0 / 1.609344;
+}
+
+  // The tiles of a tiled map that a base graph was built from, so that snapshotCovering can tell without taking the
+  // update lock whether a snapshot already covers an area. Every base built since one loadTiles shares its tile
+  // lookup and use stamps; each has its own resident flags.
+struct TileCoverage
+{
+    double tileDegrees;
+    shared_ptr<const map<pair<int, int>, int>> tileAt;     // (row, col) -> tile, for every tile in the index
+    vector<bool> resident;
+    shared_ptr<vector<atomic<long long>>> lastUsed;        // Per tile, the tile clock when last needed
+};
+
+namespace
+{
+  // The rows and columns of tiles a query needs
+struct TileArea
+{
+    int firstRow, lastRow, firstCol, lastCol;
+};
+
+  // The tiles overlapping the points' bounding box grown by marginMiles in each direction
+TileArea tileArea(const vector<GeoCoord>& points, double marginMiles, double tileDegrees)
+{
+    double minLat = points[0].latitude, maxLat = minLat, minLon = points[0].longitude, maxLon = minLon;
+    for (const GeoCoord& gc : points)
+    {
+        minLat = min(minLat, gc.latitude);
+        maxLat = max(maxLat, gc.latitude);
+        minLon = min(minLon, gc.longitude);
+        maxLon = max(maxLon, gc.longitude);
+    }
+    double latMargin = marginMiles / MILES_PER_DEGREE;
+    double lonMargin = latMargin / max(0.01, cos(deg2rad(max(fabs(minLat), fabs(maxLat)))));
+    return TileArea{ (int) floor((minLat - latMargin) / tileDegrees), (int) floor((maxLat + latMargin) / tileDegrees),
+                     (int) floor((minLon - lonMargin) / tileDegrees), (int) floor((maxLon + lonMargin) / tileDegrees) };
+}
+
+  // Calls visit(tile) for every tile in tileAt within area: by looking up each cell of a small area, or by going
+  // through tileAt for an area with more cells than the index has tiles
+template<typename Visitor>
+void forEachTile(const map<pair<int, int>, int>& tileAt, const TileArea& area, Visitor visit)
+{
+    long long cells = (long long) (area.lastRow - area.firstRow + 1) * (area.lastCol - area.firstCol + 1);
+    if (cells > (long long) tileAt.size())
+    {
+        for (const auto& [cell, tile] : tileAt)
+        {
+            if (cell.first >= area.firstRow && cell.first <= area.lastRow && cell.second >= area.firstCol && cell.second <= area.lastCol)
+                visit(tile);
+        }
+        return;
+    }
+    for (int row = area.firstRow; row <= area.lastRow; row++)
+    {
+        for (int col = area.firstCol; col <= area.lastCol; col++)
+        {
+            map<pair<int, int>, int>::const_iterator found = tileAt.find(make_pair(row, col));
+            if (found != tileAt.end())
+                visit(found->second);
+        }
+    }
+}
+}  // namespace
+
 class StreetMapImpl
 {
   public:
     StreetMapImpl();
     ~StreetMapImpl();
     bool load(string mapFile);
-    bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
-    
+    bool loadTiles(string indexFile, size_t memoryBudget);
+    bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs);
+    bool addSegment(const StreetSegment& seg);
+    bool removeSegment(const GeoCoord& start, const GeoCoord& end);
+    bool setClosed(const GeoCoord& start, const GeoCoord& end, bool closed);
+    shared_ptr<const StreetMapSnapshot> snapshot() const;
+    shared_ptr<const StreetMapSnapshot> snapshotCovering(const vector<GeoCoord>& points, double marginMiles);
+    void setNodeOrder(NodeOrder order);
+
   private:
-    ExpandableHashMap<GeoCoord, vector<StreetSegment>>* m_hashMap;
-    /*
-    ExpandableHashMap<GeoCoord, vector<StreetSegment*>>* m_hashMap;
-    vector<StreetSegment> m_streetSegments;
-    */
-      // Adds an association of GeoCoord g and StreetSegment* s to the hashmap
-    void addToHashMap(const GeoCoord& g, StreetSegment s);
+    shared_ptr<const StreetMapSnapshot> m_current;  // Published with atomic_store, read with atomic_load
+    mutex m_updateMutex;                            // Serializes load and updates (and tile changes); readers only
+                                                    // take it to load tiles
+    ExpandableHashMap<string, int> m_nameIds;       // Street name -> name id, for load and addSegment
+    NodeOrder m_nodeOrder;                          // How load numbers nodes
+
+      // A tiled map (loadTiles): the tiles in memory, and what it takes to rebuild the graph from them
+    struct TileSegment
+    {
+        int name;           // Index in m_tileNames
+        GeoCoord start;
+        GeoCoord end;
+        double length;
+        int owner;          // The tile the segment is taken from when both of its tiles are loaded
+    };
+    struct ResidentTile
+    {
+        vector<TileSegment> segments;
+        size_t bytes;           // Estimated memory use, here and in the graph built from it
+    };
+    struct Update
+    {
+        enum Kind { ADD, REMOVE, CLOSE, REOPEN } kind;
+        StreetSegment seg;
+    };
+    MapTileIndex m_tileIndex;                       // No tiles unless loaded with loadTiles
+    shared_ptr<const map<pair<int, int>, int>> m_tileAt;  // (row, col) -> index in m_tileIndex.tiles
+    vector<unique_ptr<ResidentTile>> m_resident;    // Parallel to m_tileIndex.tiles; nullptr if not in memory
+    size_t m_residentBytes;
+    size_t m_tileBudget;                            // 0 if tiles are never evicted
+    atomic<long long> m_tileClock;                  // Stamps tile use, for evicting the least recently used
+    shared_ptr<vector<atomic<long long>>> m_tileLastUsed;   // Per tile, m_tileClock when last needed
+    vector<string> m_tileNames;                     // Street names of every tile loaded so far
+    ExpandableHashMap<string, int> m_tileNameIds;
+      // Live updates since loadTiles, by segment (either direction). Updates to different segments don't interact, so
+      // only each segment's own order matters, and logUpdate merges the ones that cannot change the outcome: the log
+      // holds at most three updates per segment ever updated, however often it is.
+    map<pair<GeoCoord, GeoCoord>, vector<Update>> m_updates;
+
+      // Splits map data text into parsed lines, in blocks of lines parsed in parallel
+    vector<vector<ParsedLine>> parseMapText(const string& text);
+      // Builds a base graph with the given street names from segments (in file order)
+    shared_ptr<GraphBase> buildBase(shared_ptr<vector<string>> names, const vector<MapSegment>& segments) const;
+    shared_ptr<GraphDelta> emptyDelta(const GraphBase& base) const;
+    void publishLoaded(shared_ptr<const GraphBase> base);
+      // Loads (and stamps as used) the tiles around points, evicting others if over budget; the caller holds
+      // m_updateMutex
+    void loadTilesCovering(const vector<GeoCoord>& points, double marginMiles);
+    void loadTile(size_t t);
+    void rebuildFromTiles();
+    void logUpdate(const Update& update);
+      // Applies update to the current map and publishes the result, or returns false if it changes nothing
+    bool update(const Update& update);
+      // The updates themselves: each writes its changes to current into delta, which is either a copy of current's
+      // delta or (replaying the log) current's delta itself, and returns false, writing nothing, if there are none.
+      // The caller holds m_updateMutex.
+    bool apply(const StreetMapSnapshot& current, GraphDelta& delta, const Update& update);
+    bool applyAddSegment(const StreetMapSnapshot& current, GraphDelta& delta, const StreetSegment& seg);
+    bool applyRemoveSegment(const StreetMapSnapshot& current, GraphDelta& delta, const GeoCoord& start, const GeoCoord& end);
+    bool applySetClosed(const StreetMapSnapshot& current, GraphDelta& delta, const GeoCoord& start, const GeoCoord& end,
+                        bool closed);
+
+      // Makes base + delta the current version of the map, first folding the delta into a new base if it has grown
+    void publish(const StreetMapSnapshot& current, shared_ptr<const GraphBase> base, shared_ptr<GraphDelta> delta);
+      // Builds a new base graph whose adjacency includes every list replaced in the delta
+    shared_ptr<const GraphBase> compact(const StreetMapSnapshot& current) const;
+      // Returns the delta's (modifiable) adjacency list for node, copying it from current if not touched before
+    vector<GraphEdge>& touch(const StreetMapSnapshot& current, GraphDelta& delta, int node) const;
+      // Returns the id of a street name, adding it to the delta if the map has never seen it
+    int nameIdFor(const string& name, const StreetMapSnapshot& current, GraphDelta& delta);
       // Returns true if the string parameter is a street name. Otherwise, return false
     bool isStreetName(string str);
 };
 
+namespace
+{
+  // Once this many nodes have replaced adjacency lists, updates fold them back into the base graph
+int compactionThreshold(int nodeCount)
+{
+    return max(1024, nodeCount / 32);
+}
+
+  // A segment read by load, as a directed edge between node ids
+struct PendingEdge
+{
+    int from;
+    int to;
+    int name;
+    double length;
+};
+
+  // Position of (x, y) along a Hilbert curve filling the 65536 x 65536 grid
+uint64_t hilbertIndex(uint32_t x, uint32_t y)
+{
+    const uint32_t N = 1u << 16;
+    uint64_t d = 0;
+    for (uint32_t s = N / 2; s > 0; s /= 2)
+    {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t) s * s * ((3 * rx) ^ ry);
+          // Rotate the quadrant so the curve inside it has the standard orientation
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = N - 1 - x;
+                y = N - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return d;
+}
+
+  // Node ids in order along a Hilbert curve over the map's bounding box (ties keep file order)
+vector<int> hilbertOrder(const vector<GeoCoord>& coords)
+{
+    int nodeCount = (int) coords.size();
+    double minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+    for (int n = 0; n < nodeCount; n++)
+    {
+        const GeoCoord& gc = coords[n];
+        if (n == 0 || gc.latitude < minLat) minLat = gc.latitude;
+        if (n == 0 || gc.latitude > maxLat) maxLat = gc.latitude;
+        if (n == 0 || gc.longitude < minLon) minLon = gc.longitude;
+        if (n == 0 || gc.longitude > maxLon) maxLon = gc.longitude;
+    }
+    double latScale = (maxLat > minLat) ? 65535 / (maxLat - minLat) : 0;
+    double lonScale = (maxLon > minLon) ? 65535 / (maxLon - minLon) : 0;
+    vector<pair<uint64_t, int>> keyed(nodeCount);
+    ThreadPool::shared().parallelFor(nodeCount, [&](size_t n) {
+        uint32_t x = (uint32_t) ((coords[n].longitude - minLon) * lonScale);
+        uint32_t y = (uint32_t) ((coords[n].latitude - minLat) * latScale);
+        keyed[n] = make_pair(hilbertIndex(x, y), (int) n);
+    });
+    sort(keyed.begin(), keyed.end());
+    vector<int> order(nodeCount);
+    for (int i = 0; i < nodeCount; i++)
+        order[i] = keyed[i].second;
+    return order;
+}
+
+  // Node ids in breadth-first order through the streets, each connected part starting from its first node in the file
+vector<int> breadthFirstOrder(int nodeCount, const vector<PendingEdge>& edges)
+{
+    vector<int> first(nodeCount + 1, 0);
+    for (const PendingEdge& e : edges)
+        first[e.from + 1]++;
+    for (int n = 0; n < nodeCount; n++)
+        first[n + 1] += first[n];
+    vector<int> targets(edges.size());
+    vector<int> next(first.begin(), first.end() - 1);
+    for (const PendingEdge& e : edges)
+        targets[next[e.from]++] = e.to;
+
+    vector<int> order;
+    order.reserve(nodeCount);
+    vector<bool> visited(nodeCount, false);
+    for (int root = 0; root < nodeCount; root++)
+    {
+        if (visited[root])
+            continue;
+        visited[root] = true;
+        size_t head = order.size();     // order doubles as the queue
+        order.push_back(root);
+        for ( ; head < order.size(); head++)
+        {
+            int curr = order[head];
+            for (int i = first[curr]; i < first[curr + 1]; i++)
+            {
+                if (!visited[targets[i]])
+                {
+                    visited[targets[i]] = true;
+                    order.push_back(targets[i]);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+shared_ptr<const StreetMapSnapshot> emptySnapshot()
+{
+    shared_ptr<GraphBase> base = make_shared<GraphBase>();
+    base->coords = make_shared<vector<GeoCoord>>();
+    base->nodeIds = make_shared<ExpandableHashMap<GeoCoord, int>>();
+    base->names = make_shared<vector<string>>();
+    base->firstEdge.push_back(0);
+    return make_shared<StreetMapSnapshot>(base, make_shared<GraphDelta>(), 0);
+}
+
+  // FNV-1a over everything that defines a loaded graph, so caches built from it can tell if they still apply
+uint64_t fingerprintOf(const GraphBase& base)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+    for (const GeoCoord& gc : *base.coords)
+    {
+        mix(gc.latitudeText.data(), gc.latitudeText.size());
+        mix(gc.longitudeText.data(), gc.longitudeText.size());
+    }
+    for (const string& name : *base.names)
+        mix(name.data(), name.size() + 1);
+    mix(base.firstEdge.data(), base.firstEdge.size() * sizeof(int));
+    for (const GraphEdge& e : base.edges)
+    {
+        mix(&e.to, sizeof(e.to));
+        mix(&e.name, sizeof(e.name));
+    }
+    return hash;
+}
+
+  // Labels base's connected components with a lock-free union-find over every edge, blocks of nodes split across the
+  // shared pool. Links always point to a smaller node id, so concurrent unions and path halving cannot make a cycle,
+  // and each component's root ends up being its smallest node. Labels are then numbered in order of those roots.
+void labelComponents(GraphBase& base)
+{
+    TRACE_SCOPE("StreetMap::labelComponents");
+    int nodeCount = base.adjacencyCount();
+    vector<atomic<int>> parent(nodeCount);
+    for (int n = 0; n < nodeCount; n++)
+        parent[n].store(n, memory_order_relaxed);
+    auto find = [&parent](int x) {
+        for (;;)
+        {
+            int p = parent[x].load();
+            if (p == x)
+                return x;
+            int grandparent = parent[p].load();
+            if (grandparent != p)
+                parent[x].compare_exchange_weak(p, grandparent);     // Path halving; losing the race is harmless
+            x = grandparent;
+        }
+    };
+    auto unite = [&parent, &find](int a, int b) {
+        for (;;)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return;
+            if (a < b)
+                swap(a, b);
+            int root = a;
+            if (parent[a].compare_exchange_strong(root, b))     // Fails if another thread linked a meanwhile
+                return;
+        }
+    };
+
+    const int BLOCK = 4096;
+    size_t blocks = (nodeCount + BLOCK - 1) / BLOCK;
+    ThreadPool::shared().parallelFor(blocks, [&](size_t block) {
+        int last = min(nodeCount, (int) (block + 1) * BLOCK);
+        for (int n = (int) block * BLOCK; n < last; n++)
+        {
+            for (int i = base.firstEdge[n]; i < base.firstEdge[n + 1]; i++)
+                unite(n, base.edges[i].to);
+        }
+    });
+    vector<int> roots(nodeCount);
+    ThreadPool::shared().parallelFor(blocks, [&](size_t block) {
+        int last = min(nodeCount, (int) (block + 1) * BLOCK);
+        for (int n = (int) block * BLOCK; n < last; n++)
+            roots[n] = find(n);
+    });
+
+    base.component.resize(nodeCount);
+    base.componentCount = 0;
+    for (int n = 0; n < nodeCount; n++)
+        base.component[n] = (roots[n] == n) ? base.componentCount++ : base.component[roots[n]];
+}
+
+bool hasEdge(const StreetMapSnapshot& snap, int from, int to)
+{
+    for (const GraphEdge& e : snap.edges(from))
+    {
+        if (e.to == to)
+            return true;
+    }
+    return false;
+}
+}  // namespace
+
+bool StreetMapSnapshot::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
+{
+    int node = nodeId(gc);
+    EdgeRange range = (node < 0) ? EdgeRange{ nullptr, nullptr } : edges(node);
+
+      // If there weren't any StreetSegment's found (or they have all been removed), return false immediately
+    if (range.empty())
+        return false;
+
+    segs.clear();
+    for (const GraphEdge& e : range)
+    {
+        if (!e.closed)
+            segs.push_back(StreetSegment(coord(node), coord(e.to), streetName(e.name)));
+    }
+    return true;
+}
+
+bool StreetMapSnapshot::componentMayExtend(int node) const
+{
+    const TileCoverage* coverage = m_base->tiles.get();
+    if (complete() || coverage == nullptr)
+        return false;
+    int label = component(node);
+    for (int n = 0; n < nodeCount(); n++)
+    {
+        if (component(n) != label)
+            continue;
+        const GeoCoord& gc = coord(n);
+        map<pair<int, int>, int>::const_iterator tile = coverage->tileAt->find(make_pair(
+            (int) floor(gc.latitude / coverage->tileDegrees), (int) floor(gc.longitude / coverage->tileDegrees)));
+        if (tile != coverage->tileAt->end() && !coverage->resident[tile->second])
+            return true;
+    }
+    return false;
+}
+
 StreetMapImpl::StreetMapImpl()
 {
-    m_hashMap = new ExpandableHashMap<GeoCoord, vector<StreetSegment>>;
+    m_current = emptySnapshot();
+    m_nodeOrder = HILBERT_ORDER;
+    m_residentBytes = 0;
+    m_tileBudget = 0;
+    m_tileClock = 0;
 }
 
 StreetMapImpl::~StreetMapImpl()
 {
-    delete m_hashMap;
 }
 
-  // Load all data from map data file into the expandable hash map
+  // Load all data from map data file into a fresh base graph, and publish it as the new version of the map
 bool StreetMapImpl::load(string mapFile)
 {
-    m_hashMap->reset();     // Reset the hashmap to load the map data file
-    
+    TRACE_SCOPE("StreetMap::load");
+    lock_guard<mutex> lock(m_updateMutex);
+
       // If there is a failure to read the file, return false
     ifstream infile(mapFile);
     if (!infile)
@@ -56,97 +488,645 @@ bool StreetMapImpl::load(string mapFile)
         cerr << "Error: Cannot open mapdata.txt!" << endl;
         return false;
     }
-    
-      // Repeatedly read lines from the file
-    string line;
-    string streetName;
-    while(getline(infile, line))
-    {
-        istringstream iss(line);
-        string startingLat, startingLong, endingLat, endingLong;
-        
-        string temp;
-          // Get the steet's name (meaning there is one string and the first char is not a digit
-        if (isStreetName(line))
-        {
-            streetName = "";
-            while (iss >> temp)
+    string text((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+    vector<vector<ParsedLine>> blocks = parseMapText(text);
+
+    shared_ptr<vector<string>> names = make_shared<vector<string>>();
+    m_nameIds.reset();
+    vector<MapSegment> segments;
+
+      // Go through the parsed lines in file order
+    int streetName = -1;
+    for (const vector<ParsedLine>& block : blocks)
+    {
+        for (const ParsedLine& parsed : block)
+        {
+            if (parsed.isName)
             {
-                if (streetName.size() != 0)
-                    streetName += " ";
-                streetName += temp;
+                const int* existing = m_nameIds.find(parsed.name);
+                if (existing != nullptr)
+                    streetName = *existing;
+                else
+                {
+                    streetName = (int) names->size();
+                    m_nameIds.associate(parsed.name, streetName);
+                    names->push_back(parsed.name);
+                }
+                continue;       // If this line is a street name, do not add it to the graph as a StreetSegment
             }
-            continue;       // If this line is a street name, do not add it to the hashmap as a StreetSegment
-        }
-        
-          // If the line does not have GeoCoords (meaning it is a line representing the number of segments), skip it
-        if (!(iss >> startingLat >> startingLong >> endingLat >> endingLong))
-            continue;   // If this line is a list of GeoCoords, do not add it to the hashmap as a StreetSegment
-        
-        GeoCoord s(startingLat, startingLong);
-        GeoCoord e(endingLat, endingLong);
-        StreetSegment segment(s, e, streetName);
-        StreetSegment reverseS(e, s, streetName);
-        addToHashMap(s, segment);
-        addToHashMap(e, reverseS);
-        /*
-        StreetSegment* segment = new StreetSegment(s, e, streetName);
-        addToHashMap(s, segment);
-        m_streetSegments.push_back(*segment);
-        StreetSegment* reverseS = new StreetSegment(e, s, streetName);
-        addToHashMap(e, reverseS);
-        m_streetSegments.push_back(*reverseS);
-        delete segment;
-        delete reverseS;
-         */
+            if (streetName < 0)
+                continue;       // A segment before any street name has nowhere to go
+            segments.push_back(MapSegment{ streetName, &parsed.start, &parsed.end, parsed.length });
+        }
     }
-    
+
+    m_tileIndex = MapTileIndex();       // A whole map replaces any tiled one
+    m_tileAt.reset();
+    m_resident.clear();
+    m_residentBytes = 0;
+    m_updates.clear();
+    publishLoaded(buildBase(names, segments));
     return true;    // File automatically closed as stream goes out of scope
 }
 
-bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
+  // Read the whole file, then parse it in blocks of lines in parallel. Each line is a street name, a segment count
+  // (skipped), or a segment of the most recent street, so every line can be parsed on its own; only numbering names
+  // and nodes in file order is left for the caller's serial pass.
+vector<vector<ParsedLine>> StreetMapImpl::parseMapText(const string& text)
 {
-    vector<StreetSegment>* v = m_hashMap->find(gc);
-    
-      // If there weren't any StreetSegment's found, return false immediately
-    if (v == nullptr)
-        return false;
-    
-      // Erase segs, since we found a StreetSegment if we got here
-    while (!segs.empty())
+    vector<size_t> lineStarts;
+    for (size_t pos = 0; pos < text.size(); )
     {
-        vector<StreetSegment>::iterator itr = segs.begin();
-        itr = segs.erase(itr);
+        lineStarts.push_back(pos);
+        size_t newline = text.find('\n', pos);
+        pos = (newline == string::npos) ? text.size() : newline + 1;
     }
     
-      // Iterate through each StreetSegment, inserting the ones that start with parameter gc
-    for (vector<StreetSegment>::iterator itr = v->begin(); itr != v->end(); itr++)
+    const size_t LINES_PER_BLOCK = 4096;
+    size_t lineCount = lineStarts.size();
+    vector<vector<ParsedLine>> blocks((lineCount + LINES_PER_BLOCK - 1) / LINES_PER_BLOCK);
+    ThreadPool::shared().parallelFor(blocks.size(), [&](size_t b) {
+        size_t firstLine = b * LINES_PER_BLOCK;
+        size_t lastLine = min(lineCount, firstLine + LINES_PER_BLOCK);
+        for (size_t l = firstLine; l < lastLine; l++)
+        {
+            size_t lineEnd = (l + 1 < lineCount) ? lineStarts[l + 1] : text.size();
+            string line = text.substr(lineStarts[l], lineEnd - lineStarts[l]);
+            istringstream iss(line);
+            string startingLat, startingLong, endingLat, endingLong;
+            
+            string temp;
+              // Get the steet's name (meaning there is one string and the first char is not a digit
+            if (isStreetName(line))
+            {
+                ParsedLine parsed{ true, "", GeoCoord(), GeoCoord(), 0 };
+                while (iss >> temp)
+                {
+                    if (parsed.name.size() != 0)
+                        parsed.name += " ";
+                    parsed.name += temp;
+                }
+                blocks[b].push_back(move(parsed));
+                continue;
+            }
+            
+              // If the line does not have GeoCoords (meaning it is a line representing the number of segments), skip it
+            if (!(iss >> startingLat >> startingLong >> endingLat >> endingLong))
+                continue;
+            GeoCoord s(startingLat, startingLong);
+            GeoCoord e(endingLat, endingLong);
+            double length = distanceEarthMiles(s, e);
+            blocks[b].push_back(ParsedLine{ false, "", s, e, length });
+        }
+    });
+    return blocks;
+}
+
+  // Numbers the segments' ends as nodes and lays the graph out as a new base
+shared_ptr<GraphBase> StreetMapImpl::buildBase(shared_ptr<vector<string>> names, const vector<MapSegment>& segments) const
+{
+    shared_ptr<vector<GeoCoord>> coords = make_shared<vector<GeoCoord>>();
+    shared_ptr<ExpandableHashMap<GeoCoord, int>> nodeIds = make_shared<ExpandableHashMap<GeoCoord, int>>();
+
+      // Returns the id of GeoCoord g, numbering nodes in the order they first appear in the file (until the renumbering below)
+    auto nodeFor = [&](const GeoCoord& g) {
+        const int* id = nodeIds->find(g);
+        if (id != nullptr)
+            return *id;
+        int newId = (int) coords->size();
+        nodeIds->associate(g, newId);
+        coords->push_back(g);
+        return newId;
+    };
+
+      // Edges are collected first, then laid out node by node (CSR) once we know how many each node has
+    vector<PendingEdge> pending;
+    pending.reserve(2 * segments.size());
+    for (const MapSegment& seg : segments)
     {
-        segs.push_back(*itr);
+        int from = nodeFor(*seg.start);
+        int to = nodeFor(*seg.end);
+          // Every segment can be travelled in both directions
+        pending.push_back(PendingEdge{ from, to, seg.name, seg.length });
+        pending.push_back(PendingEdge{ to, from, seg.name, seg.length });
     }
-    
+
+      // Renumber the nodes so that intersections near each other on the map are near each other in memory (their
+      // coordinates and their edges), instead of scattered in the order the file happens to mention them
+    if (m_nodeOrder != FILE_ORDER)
+    {
+        TRACE_SCOPE("StreetMap::reorderNodes");
+        vector<int> order = (m_nodeOrder == HILBERT_ORDER) ? hilbertOrder(*coords) : breadthFirstOrder((int) coords->size(), pending);
+        vector<int> newId(order.size());
+        shared_ptr<vector<GeoCoord>> reordered = make_shared<vector<GeoCoord>>();
+        reordered->reserve(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            newId[order[i]] = (int) i;
+            reordered->push_back((*coords)[order[i]]);
+            nodeIds->associate(reordered->back(), (int) i);
+        }
+        for (PendingEdge& e : pending)
+        {
+            e.from = newId[e.from];
+            e.to = newId[e.to];
+        }
+        coords = reordered;
+    }
+
+      // Lay the edges out by starting node; an edge's id is its position in the edge array
+    shared_ptr<GraphBase> base = make_shared<GraphBase>();
+    int nodeCount = (int) coords->size();
+    base->firstEdge.assign(nodeCount + 1, 0);
+    for (size_t i = 0; i < pending.size(); i++)
+        base->firstEdge[pending[i].from + 1]++;
+    for (int n = 0; n < nodeCount; n++)
+        base->firstEdge[n + 1] += base->firstEdge[n];
+    base->edges.resize(pending.size());
+    vector<int> next(base->firstEdge.begin(), base->firstEdge.end() - 1);
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        int id = next[pending[i].from]++;
+        base->edges[id] = GraphEdge{ id, pending[i].to, pending[i].name, pending[i].length, false };
+    }
+    base->coords = coords;
+    base->nodeIds = nodeIds;
+    base->names = names;
+    base->fingerprint = fingerprintOf(*base);
+    labelComponents(*base);
+    return base;
+}
+
+  // A delta with no updates yet, for base as the next version loaded
+shared_ptr<GraphDelta> StreetMapImpl::emptyDelta(const GraphBase& base) const
+{
+    shared_ptr<GraphDelta> delta = make_shared<GraphDelta>();
+    delta->nextEdgeId = (int) base.edges.size();
+    delta->nextComponent = base.componentCount;
+    delta->loadVersion = m_current->version() + 1;
+    return delta;
+}
+
+  // Publishes base as a freshly loaded map, with no updates yet
+void StreetMapImpl::publishLoaded(shared_ptr<const GraphBase> base)
+{
+    publish(*m_current, base, emptyDelta(*base));     // As the delta's load version
+}
+
+  // Reads only the index; every tile starts out unloaded
+bool StreetMapImpl::loadTiles(string indexFile, size_t memoryBudget)
+{
+    TRACE_SCOPE("StreetMap::loadTiles");
+    lock_guard<mutex> lock(m_updateMutex);
+    MapTileIndex index;
+    if (!index.read(indexFile))
+    {
+        cerr << "Error: Cannot read tile index " << indexFile << "!" << endl;
+        return false;
+    }
+
+    m_tileIndex = index;
+    shared_ptr<map<pair<int, int>, int>> tileAt = make_shared<map<pair<int, int>, int>>();
+    for (size_t t = 0; t < m_tileIndex.tiles.size(); t++)
+        (*tileAt)[make_pair(m_tileIndex.tiles[t].row, m_tileIndex.tiles[t].col)] = (int) t;
+    m_tileAt = tileAt;
+    m_tileLastUsed = make_shared<vector<atomic<long long>>>(m_tileIndex.tiles.size());
+    m_resident.clear();
+    m_resident.resize(m_tileIndex.tiles.size());
+    m_residentBytes = 0;
+    m_tileBudget = memoryBudget;
+    m_tileNames.clear();
+    m_tileNameIds.reset();
+    m_updates.clear();
+    rebuildFromTiles();
     return true;
 }
 
-void StreetMapImpl::addToHashMap(const GeoCoord& g, StreetSegment s)
+shared_ptr<const StreetMapSnapshot> StreetMapImpl::snapshotCovering(const vector<GeoCoord>& points, double marginMiles)
 {
-      // If the GeoCoord is already an existing key, simply add the street segment to the vector
-    if (m_hashMap->find(g))
+    shared_ptr<const StreetMapSnapshot> current = snapshot();
+    if (current->complete() || points.empty())
+        return current;
+
+      // Usually the tiles needed are in the current version already; then there is nothing to lock
+    const TileCoverage* coverage = current->m_base->tiles.get();
+    if (coverage != nullptr)
     {
-            // Get the same vector of StreetSegment pointers
-        vector<StreetSegment>* v = m_hashMap->find(g);
-            // Add the segment to the existing vector
-        v->push_back(s);
+        TileArea area = tileArea(points, marginMiles, coverage->tileDegrees);
+        bool covered = true;
+        forEachTile(*coverage->tileAt, area, [&](int t) { covered = covered && coverage->resident[t]; });
+        if (covered)
+        {
+            long long stamp = ++m_tileClock;
+            forEachTile(*coverage->tileAt, area, [&](int t) { (*coverage->lastUsed)[t] = stamp; });
+            return current;
+        }
     }
-      // Else, if it is a new key, associate a new vector
+
+    TRACE_SCOPE("StreetMap::snapshotCovering");
+    lock_guard<mutex> lock(m_updateMutex);
+    if (!m_tileIndex.tiles.empty())     // Else loaded whole since we looked
+        loadTilesCovering(points, marginMiles);
+    return m_current;
+}
+
+void StreetMapImpl::loadTilesCovering(const vector<GeoCoord>& points, double marginMiles)
+{
+    TileArea area = tileArea(points, marginMiles, m_tileIndex.tileDegrees);
+    long long stamp = ++m_tileClock;
+    bool changed = false;
+    forEachTile(*m_tileAt, area, [&](int t) {
+        if (m_resident[t] == nullptr)
+        {
+            loadTile(t);
+            changed = true;
+        }
+        (*m_tileLastUsed)[t] = stamp;
+    });
+
+      // Over budget: evict the least recently used tiles that neither this call nor any reader since has needed
+    vector<atomic<long long>>& lastUsed = *m_tileLastUsed;
+    while (m_tileBudget > 0 && m_residentBytes > m_tileBudget)
+    {
+        int coldest = -1;
+        for (size_t t = 0; t < m_resident.size(); t++)
+        {
+            if (m_resident[t] != nullptr && lastUsed[t] < stamp && (coldest < 0 || lastUsed[t] < lastUsed[coldest]))
+                coldest = (int) t;
+        }
+        if (coldest < 0)
+            break;      // Everything resident is needed; the budget gives way
+        m_residentBytes -= m_resident[coldest]->bytes;
+        m_resident[coldest].reset();
+        changed = true;
+    }
+
+    if (changed)
+        rebuildFromTiles();
+}
+
+  // Reads tile t into memory. A tile whose file cannot be read is kept as an empty tile, so callers widening their
+  // area until the map is complete still get there.
+void StreetMapImpl::loadTile(size_t t)
+{
+    TRACE_SCOPE("StreetMap::loadTile");
+    unique_ptr<ResidentTile> tile = make_unique<ResidentTile>();
+    ifstream infile(m_tileIndex.tiles[t].file);
+    if (!infile)
+        cerr << "Error: Cannot open map tile " << m_tileIndex.tiles[t].file << "!" << endl;
+    string text((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+    vector<vector<ParsedLine>> blocks = parseMapText(text);
+
+    int streetName = -1;
+    for (vector<ParsedLine>& block : blocks)
+    {
+        for (ParsedLine& parsed : block)
+        {
+            if (parsed.isName)
+            {
+                const int* existing = m_tileNameIds.find(parsed.name);
+                if (existing != nullptr)
+                    streetName = *existing;
+                else
+                {
+                    streetName = (int) m_tileNames.size();
+                    m_tileNameIds.associate(parsed.name, streetName);
+                    m_tileNames.push_back(parsed.name);
+                }
+                continue;
+            }
+            if (streetName < 0)
+                continue;
+            map<pair<int, int>, int>::const_iterator owner =
+                m_tileAt->find(make_pair(m_tileIndex.rowOf(parsed.start.latitude), m_tileIndex.colOf(parsed.start.longitude)));
+            int ownerTile = (owner == m_tileAt->end()) ? (int) t : owner->second;
+            tile->segments.push_back(TileSegment{ streetName, move(parsed.start), move(parsed.end), parsed.length, ownerTile });
+        }
+    }
+
+      // The segments, and roughly what each adds to a graph built from them: two edges and (streets being mostly
+      // chains) one node, with its coordinate, id and hash table entry
+    tile->bytes = sizeof(ResidentTile) + tile->segments.capacity() * sizeof(TileSegment) +
+                  tile->segments.size() * (2 * sizeof(GraphEdge) + sizeof(GeoCoord) + 4 * sizeof(int));
+    m_residentBytes += tile->bytes;
+    m_resident[t] = move(tile);
+}
+
+  // Builds a base graph from the resident tiles and re-applies the live updates made since loadTiles, publishing the
+  // result only once it has them all. Costs O(resident segments + segments ever updated), paid on every tile load or
+  // eviction.
+void StreetMapImpl::rebuildFromTiles()
+{
+    TRACE_SCOPE("StreetMap::rebuildFromTiles");
+    vector<MapSegment> segments;
+    bool complete = true;
+    for (size_t t = 0; t < m_resident.size(); t++)
+    {
+        if (m_resident[t] == nullptr)
+        {
+            complete = false;
+            continue;
+        }
+          // A segment in two tiles comes from its owner, or from here if the owner is not loaded
+        for (const TileSegment& seg : m_resident[t]->segments)
+        {
+            if (seg.owner == (int) t || m_resident[seg.owner] == nullptr)
+                segments.push_back(MapSegment{ seg.name, &seg.start, &seg.end, seg.length });
+        }
+    }
+
+    shared_ptr<GraphBase> base = buildBase(make_shared<vector<string>>(m_tileNames), segments);
+    base->complete = complete;
+    shared_ptr<TileCoverage> coverage = make_shared<TileCoverage>();
+    coverage->tileDegrees = m_tileIndex.tileDegrees;
+    coverage->tileAt = m_tileAt;
+    coverage->lastUsed = m_tileLastUsed;
+    for (const unique_ptr<ResidentTile>& tile : m_resident)
+        coverage->resident.push_back(tile != nullptr);
+    base->tiles = coverage;
+    m_nameIds.reset();      // Names added by earlier updates are numbered afresh as they are replayed
+    for (size_t i = 0; i < m_tileNames.size(); i++)
+        m_nameIds.associate(m_tileNames[i], (int) i);
+
+      // The log goes straight into the new version's delta, unseen by readers: none can get the new tiles without
+      // the updates. The tiles as loaded are never published, but their version number is still taken, so that
+      // updatedSinceLoad() holds if anything was replayed.
+    shared_ptr<GraphDelta> delta = emptyDelta(*base);
+    bool replayed = false;
+    for (const auto& [segment, updates] : m_updates)
+    {
+        for (const Update& update : updates)
+        {
+            StreetMapSnapshot current(base, delta, delta->loadVersion);    // Fresh each time: it caches what delta holds
+            replayed = apply(current, *delta, update) || replayed;
+        }
+    }
+    if (replayed)
+        publish(StreetMapSnapshot(base, delta, delta->loadVersion), base, delta);
     else
+        publish(*m_current, base, delta);
+}
+
+  // A segment's log is, at most: a removal (which undoes everything before it) or a closure change, then an addition,
+  // then a closure change. A second addition finds the segment there already, a closure change right after a removal
+  // finds nothing to change, and of two closure changes in a row only the last counts.
+void StreetMapImpl::logUpdate(const Update& update)
+{
+    pair<GeoCoord, GeoCoord> key = (update.seg.end < update.seg.start) ? make_pair(update.seg.end, update.seg.start)
+                                                                       : make_pair(update.seg.start, update.seg.end);
+    vector<Update>& log = m_updates[key];
+    bool added = any_of(log.begin(), log.end(), [](const Update& u) { return u.kind == Update::ADD; });
+    bool removed = !log.empty() && log.front().kind == Update::REMOVE;
+    switch (update.kind)
+    {
+        case Update::REMOVE:
+            log.clear();
+            break;
+        case Update::ADD:
+            if (added)
+                return;
+            break;
+        case Update::CLOSE:
+        case Update::REOPEN:
+            if (removed && !added)
+                return;         // Removed, and not added back: nothing to close or reopen
+            if (!log.empty() && (log.back().kind == Update::CLOSE || log.back().kind == Update::REOPEN))
+                log.pop_back();
+            break;
+    }
+    log.push_back(update);
+}
+
+bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs)
+{
+      // A tile holds every segment touching an intersection in it, so gc's own tile is enough
+    return snapshotCovering(vector<GeoCoord>{ gc }, 0)->getSegmentsThatStartWith(gc, segs);
+}
+
+bool StreetMapImpl::addSegment(const StreetSegment& seg)
+{
+    return update(Update{ Update::ADD, seg });
+}
+
+bool StreetMapImpl::removeSegment(const GeoCoord& start, const GeoCoord& end)
+{
+    return update(Update{ Update::REMOVE, StreetSegment(start, end, "") });
+}
+
+bool StreetMapImpl::setClosed(const GeoCoord& start, const GeoCoord& end, bool closed)
+{
+    return update(Update{ closed ? Update::CLOSE : Update::REOPEN, StreetSegment(start, end, "") });
+}
+
+  // In a tiled map the update is made with the segment's tiles loaded, so it finds the segment (and an added one's
+  // ends) if the map has it, and is logged if it changed anything, to be re-applied whenever tiles are loaded or
+  // evicted
+bool StreetMapImpl::update(const Update& update)
+{
+    lock_guard<mutex> lock(m_updateMutex);
+    bool tiled = !m_tileIndex.tiles.empty();
+    if (tiled)
+        loadTilesCovering(vector<GeoCoord>{ update.seg.start, update.seg.end }, 0);
+
+    const StreetMapSnapshot& current = *m_current;    // Only writers replace m_current, and we hold the lock
+    shared_ptr<GraphDelta> delta = make_shared<GraphDelta>(*current.m_delta);
+    if (!apply(current, *delta, update))
+        return false;
+    if (tiled)
+        logUpdate(update);
+    publish(current, current.m_base, delta);
+    return true;
+}
+
+bool StreetMapImpl::apply(const StreetMapSnapshot& current, GraphDelta& delta, const Update& update)
+{
+    switch (update.kind)
+    {
+        case Update::ADD:       return applyAddSegment(current, delta, update.seg);
+        case Update::REMOVE:    return applyRemoveSegment(current, delta, update.seg.start, update.seg.end);
+        case Update::CLOSE:     return applySetClosed(current, delta, update.seg.start, update.seg.end, true);
+        case Update::REOPEN:    return applySetClosed(current, delta, update.seg.start, update.seg.end, false);
+    }
+    return false;
+}
+
+bool StreetMapImpl::applyAddSegment(const StreetMapSnapshot& current, GraphDelta& delta, const StreetSegment& seg)
+{
+    int from = current.nodeId(seg.start);
+    int to = current.nodeId(seg.end);
+    if (seg.start == seg.end || (from >= 0 && to >= 0 && hasEdge(current, from, to)))
+        return false;
+
+      // Either end may be a brand new node (e.g. the far end of a new footpath)
+    const GeoCoord* ends[2] = { &seg.start, &seg.end };
+    int* ids[2] = { &from, &to };
+    bool isNew[2] = { from < 0, to < 0 };
+    for (int i = 0; i < 2; i++)
+    {
+        if (*ids[i] >= 0)
+            continue;
+        *ids[i] = (int) (current.m_base->coords->size() + delta.addedCoords.size());
+        delta.addedNodeIds.associate(*ends[i], *ids[i]);
+        delta.addedCoords.push_back(*ends[i]);
+    }
+
+    int name = nameIdFor(seg.name, current, delta);
+    double length = distanceEarthMiles(seg.start, seg.end);
+      // touch() may rehash the delta, so each list is used before the next one is touched
+    int forwardId = delta.nextEdgeId++;
+    touch(current, delta, from).push_back(GraphEdge{ forwardId, to, name, length, false });
+    int reverseId = delta.nextEdgeId++;
+    touch(current, delta, to).push_back(GraphEdge{ reverseId, from, name, length, false });
+
+      // Keep the component labels exact: a new node takes its neighbour's label (or both a fresh one), and a segment
+      // between two components merges them, the larger label going by the smaller from now on
+    int labels[2] = { -1, -1 };
+    for (int i = 0; i < 2; i++)
+    {
+        if (!isNew[i])
+            labels[i] = current.component(*ids[i]);
+    }
+    if (isNew[0] && isNew[1])
+        labels[0] = labels[1] = delta.nextComponent++;
+    for (int i = 0; i < 2; i++)
     {
-          // Create a new vector
-        vector<StreetSegment> v;
-        v.push_back(s);
-          // Associate it in the hashmap
-        m_hashMap->associate(g, v);
+        if (isNew[i])
+            delta.addedComponents.associate(*ids[i], labels[1 - i] >= 0 ? labels[1 - i] : labels[i]);
     }
+    if (!isNew[0] && !isNew[1] && labels[0] != labels[1])
+    {
+        int kept = min(labels[0], labels[1]);
+        int merged = max(labels[0], labels[1]);
+        vector<int> renamed;
+        delta.mergedComponents.forEach([&](const int& label, int mergedInto) {
+            if (mergedInto == merged)
+                renamed.push_back(label);
+        });
+        for (int label : renamed)
+            delta.mergedComponents.associate(label, kept);
+        delta.mergedComponents.associate(merged, kept);
+    }
+    return true;
+}
+
+bool StreetMapImpl::applyRemoveSegment(const StreetMapSnapshot& current, GraphDelta& delta, const GeoCoord& start,
+                                       const GeoCoord& end)
+{
+    int from = current.nodeId(start);
+    int to = current.nodeId(end);
+    if (from < 0 || to < 0 || !hasEdge(current, from, to))
+        return false;
+
+    const int nodes[2][2] = { { from, to }, { to, from } };
+    for (int i = 0; i < 2; i++)
+    {
+        vector<GraphEdge>& edges = touch(current, delta, nodes[i][0]);
+        for (vector<GraphEdge>::iterator itr = edges.begin(); itr != edges.end(); )
+        {
+            if (itr->to == nodes[i][1])
+                itr = edges.erase(itr);
+            else
+                itr++;
+        }
+    }
+    return true;
+}
+
+bool StreetMapImpl::applySetClosed(const StreetMapSnapshot& current, GraphDelta& delta, const GeoCoord& start,
+                                   const GeoCoord& end, bool closed)
+{
+    int from = current.nodeId(start);
+    int to = current.nodeId(end);
+    if (from < 0 || to < 0 || !hasEdge(current, from, to))
+        return false;
+
+    const int nodes[2][2] = { { from, to }, { to, from } };
+    for (int i = 0; i < 2; i++)
+    {
+        vector<GraphEdge>& edges = touch(current, delta, nodes[i][0]);
+        for (size_t j = 0; j < edges.size(); j++)
+        {
+            if (edges[j].to == nodes[i][1])
+                edges[j].closed = closed;
+        }
+    }
+    return true;
+}
+
+void StreetMapImpl::setNodeOrder(NodeOrder order)
+{
+    lock_guard<mutex> lock(m_updateMutex);
+    m_nodeOrder = order;
+}
+
+shared_ptr<const StreetMapSnapshot> StreetMapImpl::snapshot() const
+{
+    return atomic_load(&m_current);
+}
+
+void StreetMapImpl::publish(const StreetMapSnapshot& current, shared_ptr<const GraphBase> base, shared_ptr<GraphDelta> delta)
+{
+    long long version = current.version() + 1;
+    if (delta->adjacency.size() > compactionThreshold(current.nodeCount()))
+    {
+        base = compact(StreetMapSnapshot(base, delta, version));
+        delta->adjacency.reset();
+          // The new base labels every node with removals reflected; closed edges still connect, as in every labelling
+        delta->addedComponents.reset();
+        delta->mergedComponents.reset();
+        delta->nextComponent = base->componentCount;
+    }
+    shared_ptr<const StreetMapSnapshot> next = make_shared<StreetMapSnapshot>(base, delta, version);
+    atomic_store(&m_current, next);
+}
+
+shared_ptr<const GraphBase> StreetMapImpl::compact(const StreetMapSnapshot& current) const
+{
+    TRACE_SCOPE("StreetMap::compact");
+      // Coordinates, node ids and names are shared with the old base; only the adjacency is rebuilt
+    shared_ptr<GraphBase> base = make_shared<GraphBase>();
+    base->coords = current.m_base->coords;
+    base->nodeIds = current.m_base->nodeIds;
+    base->names = current.m_base->names;
+    base->fingerprint = current.m_base->fingerprint;
+    base->complete = current.m_base->complete;
+    base->tiles = current.m_base->tiles;
+
+    int nodeCount = current.nodeCount();
+    base->firstEdge.reserve(nodeCount + 1);
+    base->edges.reserve(current.m_base->edges.size() + current.m_delta->adjacency.size());
+    base->firstEdge.push_back(0);
+    for (int n = 0; n < nodeCount; n++)
+    {
+        EdgeRange range = current.edges(n);
+        base->edges.insert(base->edges.end(), range.begin(), range.end());
+        base->firstEdge.push_back((int) base->edges.size());
+    }
+    labelComponents(*base);
+    return base;
+}
+
+vector<GraphEdge>& StreetMapImpl::touch(const StreetMapSnapshot& current, GraphDelta& delta, int node) const
+{
+    vector<GraphEdge>* edges = delta.adjacency.findForWrite(node);
+    if (edges == nullptr)
+    {
+        EdgeRange range = current.edges(node);
+        delta.adjacency.associate(node, vector<GraphEdge>(range.begin(), range.end()));
+        edges = delta.adjacency.findForWrite(node);
+    }
+    return *edges;
+}
+
+int StreetMapImpl::nameIdFor(const string& name, const StreetMapSnapshot& current, GraphDelta& delta)
+{
+    const int* existing = m_nameIds.find(name);
+    if (existing != nullptr)
+        return *existing;
+    int id = (int) (current.m_base->names->size() + delta.addedNames.size());
+    m_nameIds.associate(name, id);
+    delta.addedNames.push_back(name);
+    return id;
 }
 
 bool StreetMapImpl::isStreetName(string str)
@@ -180,7 +1160,63 @@ bool StreetMap::load(string mapFile)
     return m_impl->load(mapFile);
 }
 
+bool StreetMap::loadTiles(string tileIndexFile, size_t memoryBudgetBytes)
+{
+    return m_impl->loadTiles(tileIndexFile, memoryBudgetBytes);
+}
+
 bool StreetMap::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
    return m_impl->getSegmentsThatStartWith(gc, segs);
 }
+
+bool StreetMap::addSegment(const StreetSegment& seg)
+{
+    return m_impl->addSegment(seg);
+}
+
+bool StreetMap::removeSegment(const GeoCoord& start, const GeoCoord& end)
+{
+    return m_impl->removeSegment(start, end);
+}
+
+bool StreetMap::closeSegment(const GeoCoord& start, const GeoCoord& end)
+{
+    return m_impl->setClosed(start, end, true);
+}
+
+bool StreetMap::reopenSegment(const GeoCoord& start, const GeoCoord& end)
+{
+    return m_impl->setClosed(start, end, false);
+}
+
+shared_ptr<const StreetMapSnapshot> StreetMap::snapshot() const
+{
+    return m_impl->snapshot();
+}
+
+shared_ptr<const StreetMapSnapshot> StreetMap::snapshotCovering(const vector<GeoCoord>& points, double marginMiles) const
+{
+    return m_impl->snapshotCovering(points, marginMiles);
+}
+
+long long StreetMap::version() const
+{
+    return m_impl->snapshot()->version();
+}
+
+void StreetMap::setNodeOrder(NodeOrder order)
+{
+    m_impl->setNodeOrder(order);
+}
+
+DeliveryResult StreetMap::reachableWithin(const GeoCoord& origin, double maxMiles, Isochrone& result) const
+{
+      // Every node within maxMiles by road is within maxMiles as the crow flies
+    return Isochrone::compute(m_impl->snapshotCovering(vector<GeoCoord>{ origin }, maxMiles), origin, maxMiles, result);
+}
+
+DeliveryResult StreetMap::reachableWithin(const vector<GeoCoord>& origins, double maxMiles, vector<Isochrone>& results) const
+{
+    return Isochrone::computeAll(m_impl->snapshotCovering(origins, maxMiles), origins, maxMiles, results);
+}
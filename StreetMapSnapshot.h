@@ -0,0 +1,301 @@
+// StreetMapSnapshot.h
+// An immutable, versioned view of a StreetMap's road graph.
+//
+// StreetMap publishes a new snapshot for every load and every live update (addSegment, closeSegment, ...).
+// A query grabs the current snapshot once with StreetMap::snapshot() and works on it throughout, so it always
+// sees one consistent version of the map even while other threads apply updates; old versions are freed when
+// the last query holding them lets go (RCU-style publication through shared_ptr).
+//
+// Every distinct GeoCoord is a node with a dense id in [0, nodeCount()); every directed StreetSegment is an edge.
+// Edge ids are stable across live updates (a new segment gets fresh ids), so per-edge data indexed by id stays
+// valid until the next load().
+//
+// Internally a snapshot is a compact base graph (CSR adjacency built by load) plus a small delta holding the
+// adjacency lists of nodes touched since. StreetMap folds the delta back into a new base once it grows.
+//
+// Every node also carries a connected-component label, computed for each base and kept up to date by addSegment, so
+// two nodes with different labels are known to have no route between them without searching.
+
+#ifndef STREETMAPSNAPSHOT_INCLUDED
+#define STREETMAPSNAPSHOT_INCLUDED
+
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+  // Hash for node ids, used by the delta's ExpandableHashMap<int, ...>
+inline unsigned int hasher(const int& id)
+{
+    return (unsigned int) id * 2654435761u;     // Knuth's multiplicative hash
+}
+
+struct GraphEdge
+{
+    int id;             // Stable edge id, < StreetMapSnapshot::edgeIdLimit()
+    int to;             // Node this edge leads to
+    int name;           // Index of the street name, see StreetMapSnapshot::streetName
+    double length;      // Miles
+    bool closed;        // Temporarily closed (StreetMap::closeSegment); present but not traversable
+};
+
+  // A contiguous range of one node's outgoing edges
+struct EdgeRange
+{
+    const GraphEdge* first;
+    const GraphEdge* last;
+    const GraphEdge* begin() const { return first; }
+    const GraphEdge* end() const { return last; }
+    bool empty() const { return first == last; }
+};
+
+struct TileCoverage;     // Which tiles of a tiled map a base was built from; see StreetMap.cpp
+
+  // The graph as of the last load or compaction. Never modified once published.
+struct GraphBase
+{
+    std::shared_ptr<const std::vector<GeoCoord>> coords;                    // Coordinates of nodes [0, coords->size())
+    std::shared_ptr<const ExpandableHashMap<GeoCoord, int>> nodeIds;        // GeoCoord -> node id for those nodes
+    std::shared_ptr<const std::vector<std::string>> names;                  // Street names known at load time
+    std::vector<int> firstEdge;     // CSR offsets: node n's edges are edges[firstEdge[n], firstEdge[n+1])
+    std::vector<GraphEdge> edges;
+    uint64_t fingerprint = 0;       // Hash of the graph as loaded (nodes, edges, names); kept by compaction
+    std::vector<int> component;     // Connected-component label of each node in the adjacency, in [0, componentCount)
+    int componentCount = 0;
+    bool complete = true;           // False if built from some of a tiled map's tiles (StreetMap::loadTiles)
+    std::shared_ptr<const TileCoverage> tiles;  // The tiles it was built from; nullptr unless a tiled map
+
+    int adjacencyCount() const { return (int) firstEdge.size() - 1; }
+};
+
+  // A hash map that copies of a GraphDelta share: its entries are spread over CHUNKS separately allocated
+  // ExpandableHashMaps, so copying it copies CHUNKS pointers, and a write copies just the one chunk it lands in if an
+  // older copy still holds that chunk. Only StreetMap's writer, holding its update lock, writes, and only to a delta
+  // it has not published yet; published chunks are never modified.
+template<typename KeyType, typename ValueType>
+class ChunkedHashMap
+{
+  public:
+    static constexpr int CHUNKS = 64;
+
+    int size() const { return m_size; }
+
+    const ValueType* find(const KeyType& key) const
+    {
+        const Chunk* chunk = m_chunks[chunkOf(key)].get();
+        return chunk == nullptr ? nullptr : chunk->find(key);
+    }
+
+      // For modifying an existing value in place; nullptr if key is not in the map
+    ValueType* findForWrite(const KeyType& key)
+    {
+        if (find(key) == nullptr)
+            return nullptr;
+        return writable(chunkOf(key)).find(key);
+    }
+
+    void associate(const KeyType& key, const ValueType& value)
+    {
+        if (find(key) == nullptr)
+            m_size++;
+        writable(chunkOf(key)).associate(key, value);
+    }
+
+    template<typename Visitor>
+    void forEach(Visitor visit) const
+    {
+        for (const std::shared_ptr<Chunk>& chunk : m_chunks)
+        {
+            if (chunk != nullptr)
+                chunk->forEach(visit);
+        }
+    }
+
+    void reset()
+    {
+        for (std::shared_ptr<Chunk>& chunk : m_chunks)
+            chunk.reset();
+        m_size = 0;
+    }
+
+  private:
+    typedef ExpandableHashMap<KeyType, ValueType> Chunk;
+
+    std::shared_ptr<Chunk> m_chunks[CHUNKS];
+    int m_size = 0;
+
+    static int chunkOf(const KeyType& key)
+    {
+        unsigned int hasher(const KeyType& k);
+        return (int) (hasher(key) >> 26);   // The top 6 bits; each chunk's buckets come from the bottom ones
+    }
+
+    Chunk& writable(int c)
+    {
+          // A count above 1 means an older delta (or a snapshot being released right now) still holds the chunk
+        if (m_chunks[c] == nullptr || m_chunks[c].use_count() > 1)
+        {
+            std::shared_ptr<Chunk> copy = std::make_shared<Chunk>();
+            if (m_chunks[c] != nullptr)
+                m_chunks[c]->forEach([&copy](const KeyType& key, const ValueType& value) { copy->associate(key, value); });
+            m_chunks[c] = copy;
+        }
+        return *m_chunks[c];
+    }
+};
+
+  // An append-only vector that copies of a GraphDelta share, in the same way: CHUNK_SIZE elements to a chunk, so a
+  // copy costs one pointer per chunk and push_back copies at most the last, partly filled chunk.
+template<typename T>
+class ChunkedVector
+{
+  public:
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T& operator[](size_t i) const { return (*m_chunks[i / CHUNK_SIZE])[i % CHUNK_SIZE]; }
+
+    void push_back(const T& value)
+    {
+        if (m_size % CHUNK_SIZE == 0)
+        {
+            m_chunks.push_back(std::make_shared<std::vector<T>>());
+            m_chunks.back()->reserve(CHUNK_SIZE);
+        }
+        else if (m_chunks.back().use_count() > 1)
+            m_chunks.back() = std::make_shared<std::vector<T>>(*m_chunks.back());
+        m_chunks.back()->push_back(value);
+        m_size++;
+    }
+
+  private:
+    std::vector<std::shared_ptr<std::vector<T>>> m_chunks;
+    size_t m_size = 0;
+};
+
+  // Everything that changed since the base was built. Each update copies the delta and changes the copy; the
+  // copies share all but the chunks an update writes to, so an update costs O(chunks touched), not O(delta).
+struct GraphDelta
+{
+    ChunkedVector<GeoCoord> addedCoords;                // Nodes added by updates, ids starting at base coords->size()
+    ChunkedHashMap<GeoCoord, int> addedNodeIds;
+    ChunkedVector<std::string> addedNames;              // Names added by updates, ids starting at base names->size()
+    ChunkedHashMap<int, std::vector<GraphEdge>> adjacency;  // Replacement adjacency lists of touched nodes
+    int nextEdgeId = 0;
+    long long loadVersion = 0;      // The version published by the load this delta's updates build on
+    ChunkedHashMap<int, int> addedComponents;       // Component label of each node beyond the base's labels
+    ChunkedHashMap<int, int> mergedComponents;      // Label -> the label it now goes by, for components joined since
+    int nextComponent = 0;
+
+    GraphDelta() {}
+    GraphDelta(const GraphDelta& other) = default;
+    GraphDelta& operator=(const GraphDelta&) = delete;
+};
+
+class StreetMapSnapshot
+{
+  public:
+    StreetMapSnapshot(std::shared_ptr<const GraphBase> base, std::shared_ptr<const GraphDelta> delta, long long version)
+     : m_base(base), m_delta(delta), m_version(version), m_hasTouchedNodes(delta->adjacency.size() != 0),
+       m_hasMergedComponents(delta->mergedComponents.size() != 0)
+    {}
+
+    long long version() const { return m_version; }
+    int nodeCount() const { return (int) (m_base->coords->size() + m_delta->addedCoords.size()); }
+    int edgeIdLimit() const { return m_delta->nextEdgeId; }
+
+      // Identifies the loaded map data: equal fingerprints mean the same nodes (with the same ids) and edges.
+      // Data derived from one load (e.g. a RouteCache) is only valid while nothing has been updated since.
+    uint64_t fingerprint() const { return m_base->fingerprint; }
+    bool updatedSinceLoad() const { return m_version != m_delta->loadVersion; }
+      // The version the load (or, on a tiled map, the tile change) this version builds on was published as. Edge ids
+      // are only stable between versions with the same load version.
+    long long loadVersion() const { return m_delta->loadVersion; }
+      // Whether this version holds the whole map; false for a tiled map with some tiles not in memory, where a node
+      // missing or a route not found may only mean it lies in a tile that is not loaded
+    bool complete() const { return m_base->complete; }
+
+      // Returns the node id of gc, or -1 if gc is not on the map
+    int nodeId(const GeoCoord& gc) const
+    {
+        const int* id = m_base->nodeIds->find(gc);
+        if (id == nullptr && !m_delta->addedCoords.empty())
+            id = m_delta->addedNodeIds.find(gc);
+        return id == nullptr ? -1 : *id;
+    }
+
+    const GeoCoord& coord(int node) const
+    {
+        int baseCount = (int) m_base->coords->size();
+        return node < baseCount ? (*m_base->coords)[node] : m_delta->addedCoords[node - baseCount];
+    }
+
+    const std::string& streetName(int name) const
+    {
+        int baseCount = (int) m_base->names->size();
+        return name < baseCount ? (*m_base->names)[name] : m_delta->addedNames[name - baseCount];
+    }
+
+      // Outgoing edges of node, including closed ones (callers skip edges with closed set)
+    EdgeRange edges(int node) const
+    {
+        if (m_hasTouchedNodes)
+        {
+            const std::vector<GraphEdge>* replaced = m_delta->adjacency.find(node);
+            if (replaced != nullptr)
+                return EdgeRange{ replaced->data(), replaced->data() + replaced->size() };
+        }
+        if (node < m_base->adjacencyCount())
+        {
+            const GraphEdge* edges = m_base->edges.data();
+            return EdgeRange{ edges + m_base->firstEdge[node], edges + m_base->firstEdge[node + 1] };
+        }
+        return EdgeRange{ nullptr, nullptr };
+    }
+
+      // Connected-component label of node (segments are two-way, so components are undirected). Closed edges still
+      // connect components, so that reopening one never relabels anything, and removals are not reflected until the
+      // next compaction; so equal labels only mean there may be a route, and different labels mean there is none.
+    int component(int node) const
+    {
+        int label;
+        if (node < (int) m_base->component.size())
+            label = m_base->component[node];
+        else
+        {
+            const int* added = m_delta->addedComponents.find(node);
+            if (added == nullptr)
+                return -1;
+            label = *added;
+        }
+        if (m_hasMergedComponents)
+        {
+            const int* merged = m_delta->mergedComponents.find(label);
+            if (merged != nullptr)
+                label = *merged;
+        }
+        return label;
+    }
+    bool sameComponent(int a, int b) const { return component(a) == component(b); }
+      // On a tiled map, whether node's component may go on into tiles not in memory, i.e. some node with its label
+      // lies in a tile that is not loaded (so that node's other segments are missing). If not, the component is here
+      // whole, and loading more tiles cannot connect it to anything else. O(nodeCount()); always false when complete.
+    bool componentMayExtend(int node) const;
+
+      // StreetMap::getSegmentsThatStartWith against this version of the map. Closed segments are left out, but a
+      // GeoCoord whose segments are all closed is still on the map (returns true with segs empty).
+    bool getSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+
+  private:
+    friend class StreetMapImpl;
+    std::shared_ptr<const GraphBase> m_base;
+    std::shared_ptr<const GraphDelta> m_delta;
+    long long m_version;
+    bool m_hasTouchedNodes;     // Lets edges() skip the delta lookup entirely in the common no-updates case
+    bool m_hasMergedComponents; // ... and component() skip its alias lookup
+};
+
+#endif // STREETMAPSNAPSHOT_INCLUDED
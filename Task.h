@@ -0,0 +1,149 @@
+// Task.h
+// Task<T>: a lazily-started C++20 coroutine producing a T, the return type of the async planning API
+// (see AsyncPlanning.h).
+//
+//   Task<PlanResult> dispatch(const DeliveryPlanner& planner, ...)
+//   {
+//       PlanResult plan = co_await planner.generateDeliveryPlanAsync(depot, deliveries);   // No thread blocks here
+//       ...
+//   }
+//
+// A task does nothing until it is co_awaited, waited for with get(), or handed to startTask(). The async API's
+// tasks hop onto ThreadPool::shared() with co_await resumeOn(pool), so awaiting one parks only the awaiting
+// coroutine; when the work finishes, the awaiter resumes on the pool thread that did it.
+
+#ifndef TASK_INCLUDED
+#define TASK_INCLUDED
+
+#include "ThreadPool.h"
+#include <coroutine>
+#include <exception>
+#include <latch>
+#include <optional>
+#include <utility>
+
+template<typename T>
+class Task
+{
+  public:
+    struct promise_type
+    {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;   // The coroutine co_awaiting this task, if any
+        std::latch* finished = nullptr;         // Otherwise, what get() is blocked on
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+          // On completion, transfer straight to the awaiting coroutine (no stack growth), or release get()
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                promise_type& promise = h.promise();
+                if (promise.continuation)
+                    return promise.continuation;
+                if (promise.finished != nullptr)
+                    promise.finished->count_down();     // The frame may be destroyed from here on
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        template<typename U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+      // co_await support: start the task, and resume the awaiting coroutine with its result
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+    T await_resume() { return result(); }
+
+      // Runs the task and blocks the calling thread until it is done. For code that is not a coroutine itself;
+      // never call it from a ThreadPool worker.
+    T get()
+    {
+        std::latch finished(1);
+        m_handle.promise().finished = &finished;
+        m_handle.resume();
+        finished.wait();
+        return result();
+    }
+
+  private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    T result()
+    {
+        promise_type& promise = m_handle.promise();
+        if (promise.error)
+            std::rethrow_exception(promise.error);
+        return std::move(*promise.value);
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+  // co_await resumeOn(pool) continues the current coroutine on one of pool's workers
+inline auto resumeOn(ThreadPool& pool)
+{
+    struct Awaiter
+    {
+        ThreadPool& pool;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { pool.submit([h] { h.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{ pool };
+}
+
+namespace detail
+{
+      // A coroutine nobody awaits: it starts at once and frees itself when it finishes
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+}
+
+  // Starts task without waiting for it; onDone is called with the result on whichever thread finishes it. This is
+  // how code that is not a coroutine keeps many tasks in flight at once. onDone (and the task) must not throw.
+template<typename T, typename Callback>
+detail::DetachedTask startTask(Task<T> task, Callback onDone)
+{
+    onDone(co_await task);
+}
+
+#endif // TASK_INCLUDED
@@ -0,0 +1,153 @@
+// ThreadPool.cpp
+// Workers, per-worker deques and stealing for ThreadPool.h
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+using namespace std;
+
+namespace
+{
+      // Which pool (if any) the current thread works for, and its index there
+    thread_local const ThreadPool* t_pool = nullptr;
+    thread_local int t_workerIndex = -1;
+
+    atomic<unsigned> g_sharedWorkerCount(0);
+}
+
+ThreadPool::ThreadPool(unsigned workerCount)
+ : m_queued(0), m_stopping(false)
+{
+    if (workerCount == 0)
+        workerCount = max(1u, thread::hardware_concurrency());
+    for (unsigned i = 0; i < workerCount; i++)
+        m_queues.push_back(unique_ptr<WorkQueue>(new WorkQueue));
+    for (unsigned i = 0; i < workerCount; i++)
+        m_threads.emplace_back([this, i] { workerLoop((int) i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (thread& worker : m_threads)
+        worker.join();
+}
+
+void ThreadPool::submit(function<void()> job)
+{
+    int self = currentWorker();
+    WorkQueue& queue = (self >= 0) ? *m_queues[self] : m_injected;
+    m_queued.fetch_add(1);      // Counted before it is visible, so the count never drops below the jobs queued
+    {
+        lock_guard<mutex> lock(queue.mutex);
+        queue.jobs.push_back(move(job));
+    }
+      // Taking the sleep mutex orders this after any worker's check of m_queued, so the wakeup can't be missed
+    {
+        lock_guard<mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+}
+
+bool ThreadPool::runPendingJob()
+{
+    function<void()> job;
+    if (!takeJob(currentWorker(), job))
+        return false;
+    job();
+    return true;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool([] {
+        unsigned count = g_sharedWorkerCount.load();
+        const char* env = getenv("DELIVERY_THREADS");
+        if (count == 0 && env != nullptr)
+            count = (unsigned) max(0, atoi(env));
+        return count;
+    }());
+    return pool;
+}
+
+void ThreadPool::setSharedWorkerCount(unsigned workerCount)
+{
+    g_sharedWorkerCount = workerCount;
+}
+
+int ThreadPool::currentWorker() const
+{
+    return (t_pool == this) ? t_workerIndex : -1;
+}
+
+bool ThreadPool::takeJob(int self, function<void()>& job)
+{
+    if (m_queued.load() == 0)
+        return false;
+
+      // Our own newest job first, then the oldest outside job, then steal the oldest job of another worker
+    if (self >= 0)
+    {
+        WorkQueue& own = *m_queues[self];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            job = move(own.jobs.back());
+            own.jobs.pop_back();
+            m_queued.fetch_sub(1);
+            return true;
+        }
+    }
+    {
+        lock_guard<mutex> lock(m_injected.mutex);
+        if (!m_injected.jobs.empty())
+        {
+            job = move(m_injected.jobs.front());
+            m_injected.jobs.pop_front();
+            m_queued.fetch_sub(1);
+            return true;
+        }
+    }
+    size_t count = m_queues.size();
+    size_t first = (self >= 0) ? (size_t) self + 1 : 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        size_t victim = (first + k) % count;
+        if ((int) victim == self)
+            continue;
+        WorkQueue& other = *m_queues[victim];
+        lock_guard<mutex> lock(other.mutex);
+        if (!other.jobs.empty())
+        {
+            job = move(other.jobs.front());
+            other.jobs.pop_front();
+            m_queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    for (;;)
+    {
+        function<void()> job;
+        if (takeJob(index, job))
+        {
+            job();
+            continue;
+        }
+        unique_lock<mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_stopping || m_queued.load() != 0; });
+        if (m_stopping && m_queued.load() == 0)
+            return;     // Stopping, and nothing left to run
+    }
+}
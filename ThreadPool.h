@@ -0,0 +1,116 @@
+// ThreadPool.h
+// The work-stealing scheduler shared by everything in the project that runs work in parallel: the map loader,
+// the router's distance matrix, the planner's leg routing, the optimizer's multi-start search and the async API.
+//
+//   ThreadPool::shared().submit([] { ... });                          // Fire and forget
+//   ThreadPool::shared().parallelFor(n, [&](size_t i) { ... });       // Returns once body(0..n-1) have all run
+//
+// Each worker owns a deque: jobs a worker submits go on the back of its own deque and it takes them back LIFO (they
+// are cache-warm), while idle workers steal from the front of other deques. Jobs submitted from outside the pool go
+// on a shared FIFO queue. Jobs run in no particular order and must not throw.
+//
+// Nothing may block a worker waiting for jobs that are still queued. parallelFor runs indices itself until none are
+// left to claim, and only then blocks, waiting for indices already running on other threads; so it is safe to call
+// from inside a job, and never runs unrelated jobs (e.g. another plan resumed by resumeOn) on the waiting stack.
+//
+// The shared pool has one worker per hardware thread unless setSharedWorkerCount() (or the DELIVERY_THREADS
+// environment variable) says otherwise.
+
+#ifndef THREADPOOL_INCLUDED
+#define THREADPOOL_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+  public:
+      // workerCount 0 means one worker per hardware thread
+    explicit ThreadPool(unsigned workerCount = 0);
+      // Runs every job already submitted, then joins the workers
+    ~ThreadPool();
+
+    void submit(std::function<void()> job);
+
+      // Runs body(i) for every i in [0, count), spread over the workers and the calling thread, and returns when all
+      // are done. body must not throw.
+    template<typename Body>
+    void parallelFor(size_t count, Body body);
+
+      // Runs one queued job on the calling thread, if there is one; returns false if there was nothing to run
+    bool runPendingJob();
+
+    unsigned workerCount() const { return (unsigned) m_threads.size(); }
+
+      // The process-wide pool, created on first use
+    static ThreadPool& shared();
+      // Sets the shared pool's worker count (0 = hardware threads). Only has an effect before the first shared().
+    static void setSharedWorkerCount(unsigned workerCount);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+  private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    void workerLoop(int index);
+      // Takes the next job for the thread with worker index self (-1 if not a worker of this pool)
+    bool takeJob(int self, std::function<void()>& job);
+    int currentWorker() const;
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;   // One per worker
+    WorkQueue m_injected;                               // Jobs submitted from outside the pool
+    std::atomic<size_t> m_queued;                       // Jobs submitted but not yet taken
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+    std::vector<std::thread> m_threads;
+};
+
+template<typename Body>
+void ThreadPool::parallelFor(size_t count, Body body)
+{
+    if (count == 0)
+        return;
+
+      // Every participant claims indices from one counter until they run out. Helpers that start after the last index
+      // was claimed find nothing to do and only touch the shared counters, never body, which may be gone by then.
+    struct Progress
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+    auto work = [progress, &body, count]() {
+        for (size_t i = progress->next.fetch_add(1); i < count; i = progress->next.fetch_add(1))
+        {
+            body(i);
+            if (progress->done.fetch_add(1, std::memory_order_release) + 1 == count)
+                progress->done.notify_all();
+        }
+    };
+
+    size_t helpers = std::min(count - 1, (size_t) workerCount());
+    for (size_t h = 0; h < helpers; h++)
+        submit(work);
+    work();
+
+      // Every index is claimed, so the ones not done are running on other threads; wait for them to finish
+    for (size_t done = progress->done.load(std::memory_order_acquire); done < count;
+         done = progress->done.load(std::memory_order_acquire))
+        progress->done.wait(done, std::memory_order_acquire);
+}
+
+#endif // THREADPOOL_INCLUDED
@@ -0,0 +1,140 @@
+// Trace.cpp
+// Per-thread span ring buffers and the Chrome trace exporter for Trace.h
+
+#include "Trace.h"
+#include <chrono>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+namespace Trace
+{
+
+namespace detail
+{
+    atomic<bool> g_enabled(false);
+}
+
+namespace
+{
+
+const size_t RING_CAPACITY = 1 << 16;   // Spans kept per thread; must be a power of two
+
+struct Span
+{
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+  // One thread's spans. Only the owning thread writes; m_head is published with release ordering so an exporter
+  // that acquires it sees every span before it.
+struct ThreadBuffer
+{
+    ThreadBuffer(int id) : threadId(id), head(0), spans(RING_CAPACITY) {}
+
+    int threadId;
+    atomic<uint64_t> head;      // Total spans ever written; the slot for the next one is head % RING_CAPACITY
+    vector<Span> spans;
+};
+
+  // Buffers outlive their threads so spans from finished workers can still be exported
+mutex g_registryMutex;
+vector<unique_ptr<ThreadBuffer>> g_buffers;
+
+ThreadBuffer* threadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr)
+    {
+        lock_guard<mutex> lock(g_registryMutex);    // Once per thread, not per span
+        g_buffers.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer((int) g_buffers.size() + 1)));
+        buffer = g_buffers.back().get();
+    }
+    return buffer;
+}
+
+const chrono::steady_clock::time_point& epoch()
+{
+    static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    return start;
+}
+
+void writeJsonString(ostream& os, const char* s)
+{
+    os << '"';
+    for (; *s != '\0'; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            os << '\\';
+        os << *s;
+    }
+    os << '"';
+}
+
+}  // namespace
+
+void setEnabled(bool enabled)
+{
+    epoch();    // Pin the time origin before the first span
+    detail::g_enabled.store(enabled, memory_order_relaxed);
+}
+
+uint64_t now()
+{
+    return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch()).count();
+}
+
+void record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadBuffer* buffer = threadBuffer();
+    uint64_t head = buffer->head.load(memory_order_relaxed);
+    Span& slot = buffer->spans[head & (RING_CAPACITY - 1)];
+    slot.name = name;
+    slot.startNs = startNs;
+    slot.endNs = endNs;
+    buffer->head.store(head + 1, memory_order_release);
+}
+
+void writeChromeTrace(ostream& os)
+{
+    lock_guard<mutex> lock(g_registryMutex);
+    ios::fmtflags oldFlags = os.flags();
+    streamsize oldPrecision = os.precision();
+    os.setf(ios::fixed);
+    os.precision(3);
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    for (size_t b = 0; b < g_buffers.size(); b++)
+    {
+        const ThreadBuffer& buffer = *g_buffers[b];
+        uint64_t head = buffer.head.load(memory_order_acquire);
+        uint64_t begin = head > RING_CAPACITY ? head - RING_CAPACITY : 0;   // Older spans were overwritten
+        for (uint64_t i = begin; i < head; i++)
+        {
+            const Span& span = buffer.spans[i & (RING_CAPACITY - 1)];
+            os << (first ? "\n" : ",\n");
+            first = false;
+            os << "{\"name\":";
+            writeJsonString(os, span.name);
+              // Chrome trace timestamps are in microseconds
+            os << ",\"cat\":\"delivery\",\"ph\":\"X\",\"ts\":" << span.startNs / 1000.0
+               << ",\"dur\":" << (span.endNs - span.startNs) / 1000.0
+               << ",\"pid\":1,\"tid\":" << buffer.threadId << "}";
+        }
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    os.flags(oldFlags);
+    os.precision(oldPrecision);
+}
+
+void clear()
+{
+    lock_guard<mutex> lock(g_registryMutex);
+    for (size_t b = 0; b < g_buffers.size(); b++)
+        g_buffers[b]->head.store(0, memory_order_release);
+}
+
+}  // namespace Trace
@@ -0,0 +1,101 @@
+// Trace.h
+// Lightweight scoped tracing for the planning pipeline.
+//
+//   TRACE_SCOPE("DeliveryPlanner::generateDeliveryPlan");   // Span lasts until the end of the enclosing scope
+//
+//   TraceScope legs("routeLegs");                           // Or close a span explicitly
+//   ...
+//   legs.end();
+//
+// Each thread appends finished spans to its own fixed-size ring buffer, so recording never takes a lock; when a
+// buffer is full the oldest spans are overwritten. Tracing is off until Trace::setEnabled(true), and a disabled
+// span costs one relaxed atomic load. Building with DELIVERY_NO_TRACING compiles every span away entirely.
+// Span names must be string literals (or otherwise outlive the trace), since only the pointer is stored.
+
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace Trace
+{
+    void setEnabled(bool enabled);
+    inline bool isEnabled();
+
+      // Nanoseconds on a monotonic clock, relative to the first use of tracing in this process
+    std::uint64_t now();
+
+      // Appends a finished span to the calling thread's ring buffer
+    void record(const char* name, std::uint64_t startNs, std::uint64_t endNs);
+
+      // Writes every buffered span, from all threads, in Chrome trace event JSON (load it in chrome://tracing or
+      // https://ui.perfetto.dev). Call it once the traced work has finished; spans still being written by other
+      // threads at the same moment may come out torn.
+    void writeChromeTrace(std::ostream& os);
+
+      // Discards all buffered spans. Call it only while no other thread is tracing.
+    void clear();
+
+    namespace detail
+    {
+        extern std::atomic<bool> g_enabled;
+    }
+
+    inline bool isEnabled()
+    {
+        return detail::g_enabled.load(std::memory_order_relaxed);
+    }
+}
+
+#ifdef DELIVERY_NO_TRACING
+
+class TraceScope
+{
+  public:
+    explicit TraceScope(const char*) {}
+    void end() {}
+};
+
+#define TRACE_SCOPE(name) do {} while (false)
+
+#else
+
+class TraceScope
+{
+  public:
+    explicit TraceScope(const char* name)
+     : m_name(Trace::isEnabled() ? name : nullptr), m_start(m_name != nullptr ? Trace::now() : 0)
+    {}
+
+    ~TraceScope()
+    {
+        end();
+    }
+
+      // Closes the span now rather than at the end of the scope
+    void end()
+    {
+        if (m_name != nullptr)
+        {
+            Trace::record(m_name, m_start, Trace::now());
+            m_name = nullptr;
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* m_name;     // nullptr if tracing was disabled when the span began (or the span already ended)
+    std::uint64_t m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+#endif // DELIVERY_NO_TRACING
+
+#endif // TRACE_INCLUDED
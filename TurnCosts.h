@@ -0,0 +1,50 @@
+// TurnCosts.h
+// Turn penalties for PointToPointRouter's turn-aware (edge-based) search mode.
+//
+// With turn costs set, the router searches over directed street segments rather than intersections, and moving
+// from one segment onto the next costs the next segment's cost plus cost() of the turn between them. Penalties are
+// in the same units as the route's edge costs: miles by default, or whatever an EdgeWeights overlay uses.
+// The turn angle is measured exactly as DeliveryPlanner measures it (angleBetween2Lines), so `turn` is charged for
+// precisely the moves that become Turn commands.
+
+#ifndef TURNCOSTS_INCLUDED
+#define TURNCOSTS_INCLUDED
+
+#include <cmath>
+
+struct TurnCosts
+{
+    double turn = 0.02;         // Charged when the street name changes with a turn of at least 1 degree (a Turn command)
+    double perDegree = 0.0001;  // Charged per degree away from straight ahead, on every move
+    double uTurn = 0.25;        // Extra charge for turning back by more than uTurnAngle degrees
+    double uTurnAngle = 170;
+
+      // angle is angleBetween2Lines(incoming, outgoing), in [0, 360)
+    double cost(double angle, bool streetChanges) const
+    {
+        double deviation = angle <= 180 ? angle : 360 - angle;     // 0 = straight ahead, 180 = turning right back
+        double c = perDegree * deviation;
+        if (streetChanges && angle >= 1 && angle <= 359)
+            c += turn;
+        if (deviation > uTurnAngle)
+            c += uTurn;
+        return c;
+    }
+
+      // The heading of the line from (lat1, lon1) to (lat2, lon2), in degrees, as angleOfLine computes it
+    static double bearing(double lat1, double lon1, double lat2, double lon2)
+    {
+        return std::atan2(lat2 - lat1, lon2 - lon1) * 180 / (4 * std::atan(1.0));
+    }
+
+      // angleBetween2Lines for two headings from bearing()
+    static double angleBetween(double bearing1, double bearing2)
+    {
+        double result = bearing2 - bearing1;
+        if (result < 0)
+            result += 360;
+        return result;
+    }
+};
+
+#endif // TURNCOSTS_INCLUDED
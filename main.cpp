@@ -1,30 +1,114 @@
 #include "provided.h"
+#include "AsyncPlanning.h"
+#include "CommandSerializer.h"
+#include "DeliveryFile.h"
+#include "DeliveryPlan.h"
+#include "Isochrone.h"
+#include "Polyline.h"
+#include "RouteCache.h"
+#include "Trace.h"
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <list>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
 bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
-bool parseDelivery(string line, string& lat, string& lon, string& item);
+int planInBatches(const StreetMap& sm, string deliveriesFile, size_t batchSize, shared_ptr<const RouteCache> routeCache);
+int warmRouteCache(const StreetMap& sm, string deliveriesFile, string cacheFile, size_t stops);
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+      // --batch=n replays a (large) delivery file as independent plans of n deliveries each;
+      // --binary=file also writes the plan's commands to file in the compact binary format (CommandSerializer.h);
+      // --route-cache=file answers routes from a persisted RouteCache file where it can (RouteCache.h);
+      // --warm-cache=n adds the depot legs to and from the file's n most frequent stops to that cache, then exits;
+      // --max-miles=x leaves out (and lists) deliveries more than x road miles from the depot (Isochrone.h);
+      // --polyline=file also writes each leg's route to file as an encoded polyline, one leg per line (Polyline.h),
+      // simplified to within x miles of the roads taken with --simplify=x;
+      // --tiled[=mb] treats mapdata.txt as a tile index (MapTiles.h, written by mapgen --split) and loads tiles as
+      // the routes need them, keeping them within an estimated mb megabytes if given
+    size_t batchSize = 0;
+    string binaryFile;
+    string cacheFile;
+    size_t warmStops = 0;
+    double maxMiles = 0;
+    string polylineFile;
+    double simplifyMiles = 0;
+    bool tiled = false;
+    size_t tileBudget = 0;
+    bool badOption = false;
+    for (int i = 3; i < argc; i++)
     {
-        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt" << endl;
+        string option = argv[i];
+        if (option.compare(0, 8, "--batch=") == 0 && atol(argv[i] + 8) > 0)
+            batchSize = (size_t) atol(argv[i] + 8);
+        else if (option.compare(0, 9, "--binary=") == 0 && option.size() > 9)
+            binaryFile = option.substr(9);
+        else if (option.compare(0, 14, "--route-cache=") == 0 && option.size() > 14)
+            cacheFile = option.substr(14);
+        else if (option.compare(0, 13, "--warm-cache=") == 0 && atol(argv[i] + 13) > 0)
+            warmStops = (size_t) atol(argv[i] + 13);
+        else if (option.compare(0, 12, "--max-miles=") == 0 && atof(argv[i] + 12) > 0)
+            maxMiles = atof(argv[i] + 12);
+        else if (option.compare(0, 11, "--polyline=") == 0 && option.size() > 11)
+            polylineFile = option.substr(11);
+        else if (option.compare(0, 11, "--simplify=") == 0 && atof(argv[i] + 11) > 0)
+            simplifyMiles = atof(argv[i] + 11);
+        else if (option == "--tiled")
+            tiled = true;
+        else if (option.compare(0, 8, "--tiled=") == 0 && atof(argv[i] + 8) > 0)
+        {
+            tiled = true;
+            tileBudget = (size_t) (atof(argv[i] + 8) * 1024 * 1024);
+        }
+        else
+            badOption = true;
+    }
+    if (argc < 3 || badOption || (warmStops > 0 && cacheFile.empty()) || (simplifyMiles > 0 && polylineFile.empty()))
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt [--batch=n] [--binary=file] [--route-cache=file [--warm-cache=n]] [--max-miles=x] [--polyline=file [--simplify=x]] [--tiled[=mb]]" << endl;
         return 1;
     }
 
+      // DELIVERY_TRACE=trace.json writes a Chrome trace of the run to trace.json
+    const char* traceFile = getenv("DELIVERY_TRACE");
+    if (traceFile != nullptr)
+        Trace::setEnabled(true);
+
     StreetMap sm;
         
-    if (!sm.load(argv[1]))
+    if (tiled ? !sm.loadTiles(argv[1], tileBudget) : !sm.load(argv[1]))
     {
         cout << "Unable to load map data file " << argv[1] << endl;
         return 1;
     }
 
+    if (warmStops > 0)
+        return warmRouteCache(sm, argv[2], cacheFile, warmStops);
+
+      // A missing or out-of-date cache file just means every route is searched for
+    shared_ptr<const RouteCache> routeCache;
+    if (!cacheFile.empty())
+        routeCache = RouteCache::open(cacheFile);
+
+    if (batchSize > 0)
+    {
+        int status = planInBatches(sm, argv[2], batchSize, routeCache);
+        if (traceFile != nullptr)
+        {
+            ofstream traceOut(traceFile);
+            Trace::writeChromeTrace(traceOut);
+        }
+        return status;
+    }
+
     GeoCoord depot;
     vector<DeliveryRequest> deliveries;
     if (!loadDeliveryRequests(argv[2], depot, deliveries))
@@ -33,12 +117,63 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (maxMiles > 0)
+    {
+        Isochrone serviceArea;
+        if (sm.reachableWithin(depot, maxMiles, serviceArea) == DELIVERY_SUCCESS)
+        {
+            vector<DeliveryRequest> tooFar;
+            serviceArea.filter(vector<DeliveryRequest>(deliveries), deliveries, &tooFar);
+            if (!tooFar.empty())
+            {
+                cout << tooFar.size() << " deliveries are more than " << maxMiles << " miles from the depot and were left out:\n";
+                for (const DeliveryRequest& request : tooFar)
+                    cout << "  " << request.item << " (" << request.location.latitudeText << " " << request.location.longitudeText << ")\n";
+                cout << "\n";
+            }
+        }
+    }
+
     cout << "Generating route...\n\n";
 
     DeliveryPlanner dp(&sm);
-    vector<DeliveryCommand> dcs;
+    dp.setRouteCache(routeCache);
     double totalMiles;
-    DeliveryResult result = dp.generateDeliveryPlan(depot, deliveries, dcs, totalMiles);
+      // Commands are printed as they are planned; the first ones appear while the later legs are still being routed.
+      // They are written a leg at a time (each leg ends with a Deliver), not flushed line by line.
+    bool started = false;
+    string text;
+    CommandEncoder encoder;
+    string binary;
+    auto onCommand = [&](const DeliveryCommand& dc) {
+        if (!started)
+        {
+            text += "Starting at the depot...\n";
+            started = true;
+        }
+        appendCommandText(dc, text);
+        if (dc.isDeliver())
+        {
+            cout.write(text.data(), text.size());
+            cout.flush();
+            text.clear();
+        }
+        if (!binaryFile.empty())
+            encoder.encode(dc, binary);
+    };
+    DeliveryResult result;
+    DeliveryPlan plan;
+    if (polylineFile.empty())
+        result = dp.generateDeliveryPlan(depot, deliveries, onCommand, totalMiles);
+    else
+    {
+          // Polylines need the routed legs, so the plan is kept whole (DeliveryPlan.h) and printed once it is done
+        result = dp.generateDeliveryPlan(depot, deliveries, plan);
+        totalMiles = plan.totalDistanceTravelled;
+        for (const DeliveryCommand& dc : plan.commands)
+            onCommand(dc);
+    }
+    cout.write(text.data(), text.size());
     if (result == BAD_COORD)
     {
         cout << "One or more depot or delivery coordinates are invalid." << endl;
@@ -49,54 +184,140 @@ int main(int argc, char *argv[])
         cout << "No route can be found to deliver all items." << endl;
         return 1;
     }
-    cout << "Starting at the depot...\n";
-    for (const auto& dc : dcs)
-        cout << dc.description() << endl;
+    if (!started)
+        cout << "Starting at the depot...\n";
     cout << "You are back at the depot and your deliveries are done!\n";
     cout.setf(ios::fixed);
     cout.precision(2);
     cout << totalMiles << " miles travelled for all deliveries." << endl;
+
+    if (!binaryFile.empty())
+    {
+        ofstream binaryOut(binaryFile, ios::binary);
+        binaryOut.write(binary.data(), binary.size());
+    }
+
+    if (!polylineFile.empty())
+    {
+        string polylines;
+        vector<GeoCoord> points;
+        for (const list<StreetSegment>& leg : plan.legs)
+        {
+            routeVertices(leg, points);
+            if (simplifyMiles > 0)
+                simplifyPolyline(points, simplifyMiles, points);
+            appendPolyline(points, polylines);
+            polylines += '\n';
+        }
+        ofstream polylineOut(polylineFile);
+        polylineOut.write(polylines.data(), polylines.size());
+    }
+
+    if (traceFile != nullptr)
+    {
+        ofstream traceOut(traceFile);
+        Trace::writeChromeTrace(traceOut);
+    }
 }
 
 bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v)
 {
-    ifstream inf(deliveriesFile);
-    if (!inf)
-        return false;
-    string lat;
-    string lon;
-    inf >> lat >> lon;
-    inf.ignore(10000, '\n');
-    depot = GeoCoord(lat, lon);
-    string line;
-    while (getline(inf, line))
-    {
-        string item;
-        if (parseDelivery(line, lat, lon, item))
-            v.push_back(DeliveryRequest(item, GeoCoord(lat, lon)));
-    }
-    return true;
+    return loadDeliveryFile(deliveriesFile, depot, v, &cout);
 }
 
-bool parseDelivery(string line, string& lat, string& lon, string& item)
+  // Every batchSize deliveries become a plan job on the shared pool as soon as they have been read, so planning
+  // overlaps reading the rest of the file. Prints one summary line per batch, in file order.
+int planInBatches(const StreetMap& sm, string deliveriesFile, size_t batchSize, shared_ptr<const RouteCache> routeCache)
 {
-    const size_t colon = line.find(':');
-    if (colon == string::npos)
+    DeliveryFileReader reader(deliveriesFile, &cout);
+    if (!reader.isOpen())
     {
-        cout << "Missing colon in deliveries file line: " << line << endl;
-        return false;
+        cout << "Unable to load delivery request file " << deliveriesFile << endl;
+        return 1;
     }
-    istringstream iss(line.substr(0, colon));
-    if (!(iss >> lat >> lon))
+
+    DeliveryPlanner dp(&sm);
+    dp.setRouteCache(routeCache);
+    mutex resultsMutex;
+    condition_variable batchDone;
+    deque<PlanResult> results;      // One per batch; a deque, so finished plans can be stored while more are added
+    vector<size_t> batchSizes;
+    size_t finished = 0;
+
+    auto startBatch = [&](vector<DeliveryRequest>& batch) {
+        size_t index = batchSizes.size();
+        batchSizes.push_back(batch.size());
+        {
+            lock_guard<mutex> lock(resultsMutex);
+            results.emplace_back();
+        }
+        startTask(dp.generateDeliveryPlanAsync(reader.depot(), move(batch)), [&, index](PlanResult plan) {
+            lock_guard<mutex> lock(resultsMutex);
+            results[index] = move(plan);
+            finished++;
+            batchDone.notify_one();
+        });
+        batch.clear();
+    };
+
+    DeliveryRequest request("", GeoCoord());
+    vector<DeliveryRequest> batch;
+    while (reader.next(request))
     {
-        cout << "Bad format in deliveries file line: " << line << endl;
-        return false;
+        batch.push_back(request);
+        if (batch.size() == batchSize)
+            startBatch(batch);
     }
-    item = line.substr(colon + 1);
-    if (item.empty())
+    if (!batch.empty())
+        startBatch(batch);
+
+    unique_lock<mutex> lock(resultsMutex);
+    batchDone.wait(lock, [&] { return finished == batchSizes.size(); });
+
+    cout.setf(ios::fixed);
+    cout.precision(2);
+    size_t deliveryCount = 0;
+    double totalMiles = 0;
+    for (size_t i = 0; i < results.size(); i++)
     {
-        cout << "Missing item in deliveries file line: " << line << endl;
-        return false;
+        cout << "Batch " << i + 1 << ": " << batchSizes[i] << " deliveries, ";
+        if (results[i].result == BAD_COORD)
+            cout << "one or more coordinates are invalid" << endl;
+        else if (results[i].result == NO_ROUTE)
+            cout << "no route can be found" << endl;
+        else
+        {
+            cout << results[i].totalDistanceTravelled << " miles, " << results[i].commands.size() << " commands" << endl;
+            deliveryCount += batchSizes[i];
+            totalMiles += results[i].totalDistanceTravelled;
+        }
+    }
+    cout << deliveryCount << " deliveries planned in " << results.size() << " batches, " << totalMiles << " miles travelled." << endl;
+    return 0;
+}
+
+  // Warm-up mode: extends (or creates) cacheFile with the routes between the depot and the stops that appear most
+  // often in the delivery file, so later runs (and other processes) can skip searching for them
+int warmRouteCache(const StreetMap& sm, string deliveriesFile, string cacheFile, size_t stops)
+{
+    GeoCoord depot;
+    vector<DeliveryRequest> history;
+    if (!loadDeliveryFile(deliveriesFile, depot, history, &cout))
+    {
+        cout << "Unable to load delivery request file " << deliveriesFile << endl;
+        return 1;
+    }
+
+    RouteCacheBuilder builder(&sm);
+    shared_ptr<const RouteCache> existing = RouteCache::open(cacheFile);
+    if (existing != nullptr)
+        builder.merge(*existing);
+    size_t added = builder.warmUpDepotLegs(depot, history, stops);
+    if (!builder.write(cacheFile))
+    {
+        cout << "Unable to write route cache file " << cacheFile << endl;
+        return 1;
     }
-    return true;
+    cout << "Route cache " << cacheFile << ": " << added << " routes added, " << builder.size() << " in total" << endl;
+    return 0;
 }
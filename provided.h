@@ -8,6 +8,9 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <memory>
+#include <functional>
+#include <limits>
 
 enum DeliveryResult
 {
@@ -72,6 +75,15 @@ bool operator==(const StreetSegment& lhs, const StreetSegment& rhs)
 }
 
 class StreetMapImpl;
+class StreetMapSnapshot;    // See StreetMapSnapshot.h
+class Isochrone;            // See Isochrone.h
+
+  // How StreetMap::load numbers intersections, and so lays them and their streets out in memory: in the order the file
+  // first mentions them, along a Hilbert curve over their coordinates, or breadth-first through the streets
+enum NodeOrder
+{
+    FILE_ORDER, HILBERT_ORDER, BFS_ORDER
+};
 
 class StreetMap
 {
@@ -79,7 +91,33 @@ public:
     StreetMap();
     ~StreetMap();
     bool load(std::string mapFile);
+      // A tiled map instead (see MapTiles.h): reads only the tile index. Tiles are loaded as queries need them, and
+      // once the tiles in memory are estimated to take more than memoryBudgetBytes (0: no limit), the least recently
+      // needed ones are evicted. Routers and planners ask for the tiles around their stops, widening the area as
+      // needed, so routes cross tile boundaries transparently. Live updates are kept across tile changes.
+    bool loadTiles(std::string tileIndexFile, std::size_t memoryBudgetBytes = 0);
     bool getSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+      // Live updates. Each call publishes a new version of the map in milliseconds, without a reload; queries
+      // already running keep the version they started with. Segments are two-way, like those in the map file.
+      // Each returns false (and changes nothing) if the segment already exists / does not exist.
+    bool addSegment(const StreetSegment& seg);
+    bool removeSegment(const GeoCoord& start, const GeoCoord& end);
+    bool closeSegment(const GeoCoord& start, const GeoCoord& end);     // Kept on the map, but not traversable
+    bool reopenSegment(const GeoCoord& start, const GeoCoord& end);
+      // The current version of the map, for a consistent view across many lookups
+    std::shared_ptr<const StreetMapSnapshot> snapshot() const;
+      // The same, with every tile within marginMiles of the bounding box of points loaded first (see
+      // StreetMapSnapshot::complete). For a map loaded whole, just snapshot().
+    std::shared_ptr<const StreetMapSnapshot> snapshotCovering(const std::vector<GeoCoord>& points, double marginMiles) const;
+    long long version() const;
+      // Applies to later calls to load (HILBERT_ORDER unless set). It changes how fast routes are found, not how long
+      // they are (between equally short routes, which one is returned may differ).
+    void setNodeOrder(NodeOrder order);
+      // Every intersection within maxMiles of origin by road, with its distance (a service area; see Isochrone.h).
+      // Returns BAD_COORD if origin is not on the map. The second form searches from each origin in parallel, and
+      // returns BAD_COORD, computing nothing, if any of them is not on the map.
+    DeliveryResult reachableWithin(const GeoCoord& origin, double maxMiles, Isochrone& result) const;
+    DeliveryResult reachableWithin(const std::vector<GeoCoord>& origins, double maxMiles, std::vector<Isochrone>& results) const;
       // We prevent a StreetMap object from being copied or assigned.
     StreetMap(const StreetMap&) = delete;
     StreetMap& operator=(const StreetMap&) = delete;
@@ -88,6 +126,15 @@ private:
 };
 
 class PointToPointRouterImpl;
+struct RouteStats;      // See RouteStats.h
+class EdgeWeights;      // See EdgeWeights.h
+struct TurnCosts;       // See TurnCosts.h
+template<typename T> class Task;    // See Task.h
+struct RouteResult;     // See AsyncPlanning.h
+struct PlanResult;      // See AsyncPlanning.h
+class RouteCache;       // See RouteCache.h
+struct DeliveryPlan;    // See DeliveryPlan.h
+class RoutePath;        // See RoutePath.h
 
 class PointToPointRouter
 {
@@ -99,6 +146,34 @@ public:
         const GeoCoord& end,
         std::list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+      // Same as above, but also fills *stats with this query's search statistics (if stats is not nullptr)
+    DeliveryResult generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        std::list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteStats* stats) const;
+      // The same query, returning the route as a RoutePath: its segments in one array, indexed, with no list to walk
+    DeliveryResult generatePointToPointPath(const GeoCoord& start, const GeoCoord& end, RoutePath& path, RouteStats* stats = nullptr) const;
+      // Routes minimize this overlay's edge costs (e.g. travel time) instead of distance; nullptr goes back to
+      // distance. Safe to call while other threads are routing. totalDistanceTravelled is always in miles.
+    void setEdgeWeights(std::shared_ptr<const EdgeWeights> weights);
+      // Whether the edge weights (if any) fit the map as it is now. They stop fitting once the map is reloaded, or on
+      // a tiled map once tiles are loaded or evicted; queries then route by distance, and RouteStats::weightsIgnored
+      // counts them.
+    bool edgeWeightsUsable() const;
+      // Routes also pay these penalties for every turn they make (an edge-based search); nullptr turns them off.
+      // Safe to call while other threads are routing.
+    void setTurnCosts(std::shared_ptr<const TurnCosts> turnCosts);
+      // Distance-only queries on the map as loaded are answered from this persisted cache when it has the route;
+      // nullptr turns it off. Safe to call while other threads are routing.
+    void setRouteCache(std::shared_ptr<const RouteCache> cache);
+      // Miles along the cheapest route between every pair of points (under the current edge weights; turn costs
+      // are not applied): matrix[i * points.size() + j] is points[i] -> points[j], or infinity if there is no route.
+      // Returns BAD_COORD, leaving matrix alone, if any point is not on the map.
+    DeliveryResult generateDistanceMatrix(const std::vector<GeoCoord>& points, std::vector<double>& matrix) const;
+      // The same query as a coroutine task run on the shared thread pool (include AsyncPlanning.h to use it)
+    Task<RouteResult> generatePointToPointRouteAsync(GeoCoord start, GeoCoord end) const;
       // We prevent a PointToPointRouter object from being copied or assigned.
     PointToPointRouter(const PointToPointRouter&) = delete;
     PointToPointRouter& operator=(const PointToPointRouter&) = delete;
@@ -113,9 +188,19 @@ struct DeliveryRequest
     {}
     std::string item;
     GeoCoord location;
+      // Optional timing, in hours after the robot leaves the depot: service here must start between windowOpen and
+      // windowClose (a robot that is early waits) and takes serviceTime. The defaults impose nothing.
+    double windowOpen = 0;
+    double windowClose = std::numeric_limits<double>::infinity();
+    double serviceTime = 0;
+    bool hasTiming() const
+    {
+        return windowOpen > 0 || windowClose != std::numeric_limits<double>::infinity() || serviceTime > 0;
+    }
 };
 
 class DeliveryOptimizerImpl;
+struct FleetPlan;       // See FleetPlan.h
 
 class DeliveryOptimizer
 {
@@ -127,6 +212,26 @@ public:
         std::vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+      // Time-window mode: orders deliveries so that a robot travelling crow distances at milesPerHour serves each
+      // within its window, then by crow distance. Returns false, leaving deliveries alone, if no such order was found;
+      // otherwise sets the new crow distance and the time (in hours) the robot is back at the depot. The overload
+      // above switches to this mode, at DEFAULT_MILES_PER_HOUR, when any delivery has timing.
+    static constexpr double DEFAULT_MILES_PER_HOUR = 3;
+    bool optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        std::vector<DeliveryRequest>& deliveries,
+        double milesPerHour,
+        double& newCrowDistance,
+        double& returnTime) const;
+      // Multi-robot mode: splits deliveries into one tour per robot, robot k carrying at most capacities[k] of them,
+      // minimizing total crow distance plus balanceWeight times the longest tour's. Returns false, leaving plan
+      // alone, if the robots cannot carry every delivery. Time windows are not considered.
+    bool optimizeFleet(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        const std::vector<int>& capacities,
+        FleetPlan& plan,
+        double balanceWeight = 1) const;
       // We prevent a DeliveryOptimizer object from being copied or assigned.
     DeliveryOptimizer(const DeliveryOptimizer&) = delete;
     DeliveryOptimizer& operator=(const DeliveryOptimizer&) = delete;
@@ -176,6 +281,15 @@ public:
         return m_streetName;
     }
 
+      // Read access for serializers (see CommandSerializer.h); street() is streetName() without the copy
+    bool isProceed() const { return m_type == PROCEED; }
+    bool isTurn() const { return m_type == TURN; }
+    bool isDeliver() const { return m_type == DELIVER; }
+    const std::string& street() const { return m_streetName; }
+    const std::string& direction() const { return m_direction; }
+    const std::string& item() const { return m_item; }
+    double distance() const { return m_distance; }
+
     std::string description() const
     {
         std::ostringstream oss;
@@ -220,6 +334,27 @@ public:
         const std::vector<DeliveryRequest>& deliveries,
         std::vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+      // Same plan, streamed: each command is passed to onCommand (on the calling thread) as soon as its leg has been
+      // routed, while later legs are routed in the background. BAD_COORD is detected before any command is passed
+      // on; if a later leg has NO_ROUTE, the commands already passed on stand. totalDistanceTravelled is set at the end.
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        const std::function<void(const DeliveryCommand&)>& onCommand,
+        double& totalDistanceTravelled) const;
+      // Same plan, kept together with its stops and routed legs (see DeliveryPlan.h) so it can be changed later
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        DeliveryPlan& plan) const;
+      // Adds a late delivery to plan where it adds the fewest road miles, as stop earliestStop or later (the robot has
+      // already left for the stops before it). Only the two new legs are routed, and plan.commands is patched in
+      // place. On BAD_COORD or NO_ROUTE the plan is unchanged.
+    DeliveryResult insertDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery, std::size_t earliestStop = 0) const;
+      // The buffered plan as a coroutine task run on the shared thread pool (include AsyncPlanning.h to use it)
+    Task<PlanResult> generateDeliveryPlanAsync(GeoCoord depot, std::vector<DeliveryRequest> deliveries) const;
+      // Legs are routed with this cache set (see PointToPointRouter::setRouteCache); safe to call while planning
+    void setRouteCache(std::shared_ptr<const RouteCache> cache);
       // We prevent a DeliveryPlanner object from being copied or assigned.
     DeliveryPlanner(const DeliveryPlanner&) = delete;
     DeliveryPlanner& operator=(const DeliveryPlanner&) = delete;